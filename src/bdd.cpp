@@ -12,6 +12,14 @@
 // modified over time by the Author.
 #include <cassert>
 #include <algorithm>
+#include <deque>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#ifdef WITH_THREADS
+#include <atomic>
+#include <thread>
+#endif
 #include "bdd.h"
 
 #ifndef NOOUTPUTS
@@ -43,7 +51,7 @@ template<typename T1, typename T2> struct vec2cmp {
 };
 
 // Maps a BDD definition its unique ID
-unordered_map<bdd_key, bdd_id> id_map;
+unique_table id_map;
 // Maps a BDD ID to its (unique) definition
 bdd_mmap V;
 // Controls whether or not garbage collection is enabled
@@ -53,35 +61,86 @@ size_t max_bdd_nodes = 0;
 mmap_mode bdd_mmap_mode = MMAP_NONE;
 string bdd_mmap_file = "";
 #endif
-// Maps a BDD triple (a,b,c) to the BDD corresponding to (a&b)|(~a&c)
-unordered_map<ite_memo, bdd_ref> C;
-// Maps a BDD pair (a,b) and variable list c to the BDD exists c (a&b)
-map<bools, unordered_map<array<bdd_ref, 2>, bdd_ref>, veccmp<bool>> CX;
-// Maps a BDD pair (a,b), variable list c, and permutation list d to the BDD
-// exists c (a&b) with its variables renamed according d
-map<pair<bools, bdd_shfts>, unordered_map<array<bdd_ref, 2>, bdd_ref>,
-	vec2cmp<bool, bdd_shft>> CXP;
+// Maps a BDD triple (a,b,c) to the BDD corresponding to (a&b)|(~a&c). Pairs
+// (a,b) are stored as (a,b,F) and stand for a&b.
+computed_table C;
 // Maps a BDD vector a to the BDD corresponding to a_0 & a_1 & ... & a_N
 unordered_map<bdds, bdd_ref> AM;
-// Maps a BDD vector a and variable list b to the BDD exists b (a_0 & ... & a_N)
-map<bools, unordered_map<bdds, bdd_ref>, veccmp<bool>> AMX;
-// Maps a BDD vector a, variable list b, and permutation list c to the BDD
-// exists b (a_0 & ... & a_N) with the variables renamed according c
-map<pair<bools, bdd_shfts>, unordered_map<bdds, bdd_ref>, vec2cmp<bool, bdd_shft>> AMXP;
+// An existential quantification over the variable list ex followed by a
+// renaming of the variables according to the permutation list p. Either list
+// may be empty. Each operation owns the caches of the functions applying it.
+struct ex_perm_op {
+	bools ex;
+	bdd_shfts p;
+	// The last variable that is quantified or moved
+	bdd_shft last = 0;
+	// Maps a BDD a to the BDD exists ex (a) renamed according to p
+	unordered_map<bdd_ref, bdd_ref> m1;
+	// Maps a BDD a to the BDD a with all its variables renamed according to p.
+	// Unlike m1, this renames variables beyond last.
+	unordered_map<bdd_ref, bdd_ref> mp;
+	// Maps a BDD pair (a,b) to the BDD exists ex (a&b) renamed according to p
+	unordered_map<array<bdd_ref, 2>, bdd_ref> m2;
+	// Maps a BDD vector a to the BDD exists ex (a_0 & ... & a_N) renamed
+	// according to p
+	unordered_map<bdds, bdd_ref> mn;
+	// Whether any variable is quantified
+	bool quant = false;
+	// Whether p moves every variable left after quantification by the same
+	// offset, off. Renaming then amounts to shifting the quantified BDD, see
+	// bdd::bdd_ex_shift. A shift also moves the variables past last, which
+	// renaming leaves alone, so unless off is 0 it only applies to BDDs that
+	// do not depend on any, see bdd::shiftable.
+	bool uniform = false;
+	int32_t off = 0;
+	// Maps a BDD a to T if it depends on no variable past last, F otherwise
+	unordered_map<bdd_ref, bdd_ref> mw;
+	// The ID of the operation quantifying ex without renaming, see ex_op
+	size_t exop = SIZE_MAX;
+	ex_perm_op(const bools& ex, const bdd_shfts& p) : ex(ex), p(p) {
+		for (size_t n = 0; n != ex.size(); ++n)
+			if (ex[n] || (!p.empty() && (n >= p.size() || p[n] != n)))
+				last = n;
+		for (bool x : ex) quant |= x;
+		if (p.empty()) return;
+		bool first = true;
+		uniform = true;
+		for (size_t n = 0; uniform && n != max(ex.size(), p.size()); ++n) {
+			if (n < ex.size() && ex[n]) continue;
+			const int32_t d = int32_t(n < p.size() ? p[n] : n) - int32_t(n);
+			if (first) off = d, first = false;
+			else uniform = d == off;
+		}
+	}
+};
+// The interned operations indexed by their IDs. A deque so that references to
+// an operation survive the interning of others.
+deque<ex_perm_op> O;
+// Maps the hash of a variable list and permutation list pair to the IDs of the
+// operations having that hash
+unordered_map<size_t, vector<size_t>> OH;
 // Used to store the marked set in the mark-and-sweep garbage collector
-unordered_set<bdd_id> S;
-// Maps a live BDD to the handle that keeps it alive
-unordered_map<bdd_ref, weak_ptr<bdd_handle>> bdd_handle::M;
+bools S;
+// The BDD IDs pending marking by the garbage collector
+vector<bdd_id> SM;
+// The free BDD IDs available for reuse, lowest ID last
+vector<bdd_id> FR;
+// Maps a BDD ID to the generation of the computed table in which the BDD
+// occupying it was created, or to unborn if it is free
+vector<uint32_t> B;
+const uint32_t unborn = uint32_t(-1);
+// A step of an operation run by the apply engine: its operands, and once
+// split, the variable it branches on and the shift to add back to the result
+struct bdd::frame {
+	bdd_ref x, y, z;
+	bdd_shft v = 0, s = 0;
+	bool split = false;
+};
+thread_local vector<bdd::frame> bdd::AF;
+thread_local bdds bdd::AR;
+// Maps a BDD ID to the number of handles held on it, sized along with B
+vector<uint32_t> bdd_handle::R;
 spbdd_handle htrue, hfalse;
-// Maps a BDD a and variable list b to the BDD corresponding to exists b (a)
-map<bools, unordered_map<bdd_ref, bdd_ref>, veccmp<bool>> memos_ex;
-// Maps a BDD a and permutation list b to the BDD a with the variables renamed
-// according to b
-map<bdd_shfts, unordered_map<bdd_ref, bdd_ref>, veccmp<bdd_shft>> memos_perm;
-// Maps a BDD a, variable list b, and permutation list c to the BDD exists b (a)
-// with the variables renamed according to c
-map<pair<bdd_shfts, bools>, unordered_map<bdd_ref, bdd_ref>, vec2cmp<bdd_shft, bool>>
-	memos_perm_ex;
 
 _Pragma("GCC diagnostic push")
 _Pragma("GCC diagnostic ignored \"-Wstrict-overflow\"")
@@ -92,7 +151,9 @@ auto am_cmp = [](bdd_ref x, bdd_ref y) {
 };
 _Pragma("GCC diagnostic pop")
 
-size_t gclimit = 1e+7;
+size_t gclimit = 1e+7, gc_next = gclimit;
+// Initial size of the computed table C as a power of two
+const size_t cache_min_log2 = 16;
 
 #ifndef NOMMAP
 void bdd::init(mmap_mode m, size_t max_size, const string fn) {
@@ -107,52 +168,145 @@ void bdd::init() {
 	//	(m == MMAP_NONE ? "NONE" : "WRITE") <<
 	//	", max_size: " << max_size << ", fn: " << fn
 	//	<< ") max_bdd_nodes=" << max_bdd_nodes << "\n";)
-	S.insert(0), S.insert(1), V.emplace_back(0, 0), // dummy
+	bdd_id id0 = 0, id1 = 1;
+	C.init(cache_min_log2, B);
+	B.assign(2, 0), bdd_handle::R.assign(2, 0),
+	V.emplace_back(0, 0), // dummy
 	V.emplace_back(1, 1),
-	id_map.emplace(bdd_key(hash_pair(0, 0), 0, 0), 0),
-	id_map.emplace(bdd_key(hash_pair(1, 1), 1, 1), 1),
+	id_map.find_or_insert(0, 0, id0), id_map.find_or_insert(1, 1, id1),
 	htrue = bdd_handle::get(T), hfalse = bdd_handle::get(F);
 }
 
-#ifndef NOMMAP
-void bdd::max_bdd_size_check() {
-	//DBG(COUT << "add_check V.size()-1=" << V.size()-1
-	//	<< " max_bdd_nodes=" << max_bdd_nodes << endl;)
-	if (V.size() == max_bdd_nodes)
-		CERR << "Maximum bdd size reached. Increase the limit"
-		" with --bdd-max-size parameter. Exiting." << endl,
-		onexit = true,
-		exit(0);
-		// TODO: offer user to remap instead of exit
+/* The node store saved by bdd::save, in host byte order:
+ *
+ *   "TMLB", then version, sizeof(bdd_ref) and BDD_ID_BITS as 32 bit integers
+ *   the numbers of nodes, of unique table slots as a power of two, of their
+ *   entries and of roots as 64 bit integers
+ *   the roots, the nodes V and the unique table slots.
+ *
+ * Free nodes are stored as (0, 0). Loading maps the file read only, checks it
+ * and adopts both arrays as they are, so no node is hashed again. */
+
+struct store_header {
+	char magic[4];
+	uint32_t version, ref_size, id_bits;
+	uint64_t nodes, log2, used, roots;
+};
+
+bool bdd::save(const string& fn, const bdds& roots) {
+	ofstream os(fn, ios::binary);
+	if (!os) return o::err() << "Cannot open " << fn << endl, false;
+	const vector<unique_table::entry>& s = id_map.slots();
+	const store_header h = { { 'T', 'M', 'L', 'B' }, 1, sizeof(bdd_ref),
+		BDD_ID_BITS, V.size(), id_map.slots_log2(), id_map.size(),
+		roots.size() };
+	os.write((const char*) &h, sizeof h);
+	os.write((const char*) roots.data(), roots.size() * sizeof(bdd_ref));
+	os.write((const char*) V.data(), V.size() * sizeof(bdd));
+	os.write((const char*) s.data(), s.size() * sizeof(s[0]));
+	return (bool) os;
+}
+
+bool bdd::load(const string& fn, bdds& roots) {
+	auto fail = [&fn](const char* msg) {
+		return o::err() << fn << ": " << msg << endl, false;
+	};
+	if (V.size() != 2 || id_map.size() != 2)
+		return fail("cannot load into a nonempty BDD store");
+	memory_map m(fn);
+	store_header h;
+	if (m.error || !m.data() || m.size() < sizeof h)
+		return fail("not a BDD store");
+	memcpy(&h, m.data(), sizeof h);
+	if (memcmp(h.magic, "TMLB", 4)) return fail("not a BDD store");
+	if (h.version != 1) return fail("unsupported version");
+	if (h.ref_size != sizeof(bdd_ref) || h.id_bits != BDD_ID_BITS)
+		return fail("saved with other BDD references");
+	typedef unique_table::entry entry;
+	if (h.nodes < 2 || h.nodes >> BDD_ID_BITS || h.log2 >= 48 ||
+		h.roots > m.size() || m.size() != sizeof h + h.roots *
+			sizeof(bdd_ref) + h.nodes * sizeof(bdd) +
+			(sizeof(entry) << h.log2))
+		return fail("truncated");
+	const bdd_ref* r = (const bdd_ref*) ((const char*) m.data() + sizeof h);
+	const bdd* v = (const bdd*) (r + h.roots);
+	const entry* s = (const entry*) (v + h.nodes);
+	// Every live node is indexed under its ID, once, and refers to live
+	// nodes, every other node is free
+	auto corrupt = [&fail]() { return fail("corrupt"); };
+	if (!(v[0] == bdd(0, 0)) || !(v[1] == bdd(1, 1))) return corrupt();
+	bools live(h.nodes, false);
+	size_t n = 0;
+	for (size_t k = 0; k != size_t(1) << h.log2; ++k)
+		if (s[k].id == unique_table::empty) continue;
+		else if (s[k].id >= h.nodes || live[s[k].id] ||
+			!(v[s[k].id] == bdd(s[k].h, s[k].l))) return corrupt();
+		else live[s[k].id] = true, ++n;
+	if (n != h.used || !live[0] || !live[1]) return corrupt();
+	auto valid = [&h, &live](bdd_ref x) {
+		return GET_BDD_ID(x) < h.nodes && live[GET_BDD_ID(x)];
+	};
+	for (size_t id = 2; id != h.nodes; ++id)
+		if (live[id] ? !valid(v[id].h) || !valid(v[id].l)
+			: !(v[id] == bdd(0, 0))) return corrupt();
+	for (size_t k = 0; k != h.roots; ++k)
+		if (!valid(r[k])) return corrupt();
+	if (!id_map.adopt(s, h.log2, h.used)) return corrupt();
+	V.reserve(h.nodes), V.assign(v, v + h.nodes), FR.clear();
+	B.assign(h.nodes, C.generation()), bdd_handle::R.assign(h.nodes, 0);
+	for (bdd_id id = h.nodes; id-- > 2;)
+		if (!live[id]) B[id] = unborn, FR.push_back(id);
+	for (size_t c = 0; c != C.capacity() && C.capacity() < h.used; )
+		c = C.capacity(), C.grow();
+	gc_next = max(gclimit, (size_t) h.used << 1);
+	return roots.assign(r, r + h.roots), true;
 }
-#endif
 
 /* Make a BDD reference representing a function f that behaves like the provided
  * high reference, h, if v is set to 1, otherwise it behaves like the provided
  * low reference, l. Precondition is that h and l depend only on variables after
  * v, i.e. their shifts are more than v. */
 
-bdd_ref bdd::add(bdd_shft v, bdd_ref h, bdd_ref l) {
-	DBG(assert(GET_BDD_ID(h) && GET_BDD_ID(l)););
-	// If BDD would not branch on this variable, exclude it to preserve canonicity
-	if (h == l) return h;
+/* Turn h and l into the parts of the BDD that the reference made by add
+ * attributes, and get the inverters of that reference. */
+
+static void orient(bdd_shft v, bdd_ref& h, bdd_ref& l, bool& inv_inp,
+	bool& inv_out)
+{
 	// Apply output inversion invariant that low part can never be inverted
-	const bool inv_out = GET_INV_OUT(l);
+	inv_out = GET_INV_OUT(l);
 	// First apply the inverse shift since h and l will be attached to v
 	h = inv_out ? FLIP_INV_OUT(MINUS_SHIFT(h, v)) : MINUS_SHIFT(h, v);
 	l = inv_out ? FLIP_INV_OUT(MINUS_SHIFT(l, v)) : MINUS_SHIFT(l, v);
 	// Now we know what v's child nodes will be, order them to maximize re-use
 	// attaching an input inverter if necessary. Required for canonicity.
-	const bool inv_inp = BDD_LT(l, h);
+	inv_inp = BDD_LT(l, h);
 	if (inv_inp) swap(h, l);
-	bdd_key k = bdd_key(hash_upair(h, l), h, l);
-	unordered_map<bdd_key, bdd_id>::const_iterator it;
+}
+
+bdd_ref bdd::add(bdd_shft v, bdd_ref h, bdd_ref l) {
+	DBG(assert(GET_BDD_ID(h) && GET_BDD_ID(l)););
+	// If BDD would not branch on this variable, exclude it to preserve canonicity
+	if (h == l) return h;
+	check_var(v);
+	bool inv_inp, inv_out;
+	orient(v, h, l, inv_inp, inv_out);
 	// Find a BDD with the given high and low parts and make an attributed
 	// reference to it.
-	bdd_id id = (it = id_map.find(k)) != id_map.end() ? it->second :
-		(V.emplace_back(h, l),
-		id_map.emplace(move(k), V.size()-1),
-		V.size()-1);
+	bdd_id id = FR.empty() ? V.size() : FR.back();
+	if (!id_map.find_or_insert(h, l, id)) {
+#ifdef BDD_COMPACT_REFS
+		if (id >> BDD_ID_BITS) throw overflow_error("BDD IDs exceed "
+			"BDD_ID_BITS, build with a larger one or without "
+			"compact BDD references");
+#endif
+		if (id == V.size()) V.emplace_back(h, l);
+		else V[id] = bdd(h, l), FR.pop_back();
+		if (id == B.size())
+			B.push_back(C.generation()), bdd_handle::R.push_back(0);
+		else B[id] = C.generation();
+		if (V.size() - FR.size() > C.capacity()) C.grow();
+	}
 	return BDD_REF(id, v, inv_inp, inv_out);
 }
 
@@ -171,89 +325,308 @@ bool bdd::bdd_subsumes(bdd_ref x, bdd_ref y) {
 	return bdd_subsumes(bx.h, by.h) && bdd_subsumes(bx.l, by.l);
 }
 
+/* The apply engine runs an operation over the explicit stack of frames AF
+ * rather than recursing once per variable, so BDDs over many variables cannot
+ * overflow the call stack. The operation provides leaf(f, r), which answers
+ * the frame f by itself if it can, as for terminals or memoized operands, and
+ * canonises f's operands otherwise, split(f, h, l), which sets the variable f
+ * branches on and makes the frames of its high and low cofactors, and join(f,
+ * h, l), which makes f's result out of theirs. An operation run by another
+ * one, as bdd_or by bdd_and_ex, works on top of the stacks of its caller,
+ * which holds no reference into them meanwhile. */
+
+template <typename Op>
+bdd_ref bdd::apply(Op& op, bdd_ref x, bdd_ref y, bdd_ref z) {
+	const size_t base = AF.size();
+	bdd_ref r;
+	for (AF.push_back({ x, y, z }); AF.size() != base; ) {
+		frame f = AF.back(), h, l;
+		AF.pop_back();
+		if (f.split) {
+			const bdd_ref rl = AR.back();
+			AR.pop_back(), r = AR.back(), AR.pop_back();
+			AR.push_back(op.join(f, r, rl));
+		} else if (op.leaf(f, r)) AR.push_back(r);
+		else {
+			op.split(f, h, l), f.split = true;
+			AF.push_back(f), AF.push_back(l), AF.push_back(h);
+			// the low cofactor waits for the high one to be done
+			__builtin_prefetch(&V[GET_BDD_ID(l.x)]);
+			__builtin_prefetch(&V[GET_BDD_ID(l.y)]);
+		}
+	}
+	return r = AR.back(), AR.pop_back(), r;
+}
+
 /* Compute the conjunction of the given pair of BDDs. */
 
-bdd_ref bdd::bdd_and(bdd_ref x, bdd_ref y) {
-	DBG(assert(GET_BDD_ID(x) && GET_BDD_ID(y));)
-	if (x == F || y == F || x == FLIP_INV_OUT(y)) return F;
-	if (x == T || x == y) return y;
-	if (y == T) return x;
-	if (BDD_LT(y, x)) swap(x, y);
-	// Downshift the input BDDs by their greatest common shift. Operate on this
-	// reduced form then upshift the result by the aforementioned shift. Intent is
-	// that this canonisation increases cache hits.
-	const bdd_shft min_shift = min(GET_SHIFT(x), GET_SHIFT(y));
-	DECR_SHIFT(x, min_shift);
-	DECR_SHIFT(y, min_shift);
+struct bdd::op_and {
+	// Answers the frames not needing a split, and canonises the others
+	static bool canon(frame& f, bdd_ref& r) {
+		bdd_ref x = f.x, y = f.y;
+		DBG(assert(GET_BDD_ID(x) && GET_BDD_ID(y));)
+		if (x == F || y == F || x == FLIP_INV_OUT(y)) return r = F, true;
+		if (x == T || x == y) return r = y, true;
+		if (y == T) return r = x, true;
+		if (BDD_LT(y, x)) swap(x, y);
+		// Downshift the input BDDs by their greatest common shift. Operate
+		// on this reduced form then upshift the result by the aforementioned
+		// shift. Intent is that this canonisation increases cache hits.
+		const bdd_shft min_shift = min(GET_SHIFT(x), GET_SHIFT(y));
+		DECR_SHIFT(x, min_shift);
+		DECR_SHIFT(y, min_shift);
+		return f.x = x, f.y = y, f.s = min_shift, false;
+	}
+	bool leaf(frame& f, bdd_ref& r) const {
+		if (canon(f, r)) return true;
 #ifdef MEMO
-	ite_memo m = { x, y, F };
-	auto it = C.find(m);
-	// Upshift result to obtain answer for pre-downshifted BDDs
-	if (it != C.end()) return PLUS_SHIFT(it->second, min_shift);
+		// Upshift result to obtain answer for pre-downshifted BDDs
+		if (C.find(f.x, f.y, F, r)) return r = PLUS_SHIFT(r, f.s), true;
 #endif
-	const bdd_shft xshift = GET_SHIFT(x), yshift = GET_SHIFT(y);
-	const bdd bx = get(x), by = get(y);
-	bdd_ref r;
-	if (xshift < yshift) r = add(xshift, bdd_and(bx.h, y), bdd_and(bx.l, y));
-	else if (xshift > yshift) r = add(yshift, bdd_and(x, by.h), bdd_and(x, by.l));
-	else r = add(xshift, bdd_and(bx.h, by.h), bdd_and(bx.l, by.l));
+		return false;
+	}
+	void split(frame& f, frame& h, frame& l) const {
+		const bdd_ref x = f.x, y = f.y;
+		const bdd_shft xshift = GET_SHIFT(x), yshift = GET_SHIFT(y);
+		const bdd bx = get(x), by = get(y);
+		if (xshift < yshift)
+			f.v = xshift, h = { bx.h, y, 0 }, l = { bx.l, y, 0 };
+		else if (xshift > yshift)
+			f.v = yshift, h = { x, by.h, 0 }, l = { x, by.l, 0 };
+		else f.v = xshift, h = { bx.h, by.h, 0 }, l = { bx.l, by.l, 0 };
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) const {
+		const bdd_ref r = add(f.v, h, l);
 #ifdef MEMO
-	if (C.size() < gclimit) C.emplace(m, r);
+		C.insert(f.x, f.y, F, r);
+#endif
+		// Upshift result to obtain answer for pre-downshifted BDDs
+		return PLUS_SHIFT(r, f.s);
+	}
+};
+
+bdd_ref bdd::bdd_and(bdd_ref x, bdd_ref y) {
+#ifdef WITH_THREADS
+	if (threads > 1) return bdd_and_par(x, y);
+#endif
+	op_and op;
+	return apply(op, x, y);
+}
+
+#ifdef WITH_THREADS
+/* Conjunctions of large BDDs run on several threads. The top of the recursion
+ * is expanded into up to four subproblems per thread, which the threads take
+ * in turn, and the top is then joined by the calling thread. While the threads
+ * run nothing is resized: V, B and R are extended beforehand by a budget of new
+ * IDs handed out by par_next, and the unique table is reserved for them and
+ * inserted into by find_or_insert_mt. C is only read, each thread keeping its
+ * results to itself until they are all put in C at the end. Should the budget
+ * run out the conjunction is run again sequentially, which finds the nodes
+ * made so far, and the next budget is doubled. */
+
+size_t bdd::threads = 1;
+// Operands having fewer nodes than this are conjoined by a single thread
+const size_t par_min_nodes = 1 << 12;
+size_t par_budget = 1 << 16;
+atomic<size_t> par_next;
+size_t par_end = 0;
+// Set once a thread runs out of budget or fails, telling the others to stop
+atomic<bool> par_stop;
+bool par_region = false;
+
+bdd_ref bdd::add_mt(bdd_shft v, bdd_ref h, bdd_ref l) {
+	if (h == l) return h;
+	check_var(v);
+	bool inv_inp, inv_out;
+	orient(v, h, l, inv_inp, inv_out);
+	bdd_id id;
+	id_map.find_or_insert_mt(h, l, id, [h, l]() {
+		const size_t id = par_next++;
+		if (id >= par_end) return par_stop = true, unique_table::empty;
+		return V[id] = bdd(h, l), bdd_id(id);
+	});
+	return id == unique_table::empty ? F : BDD_REF(id, v, inv_inp, inv_out);
+}
+
+/* The conjunction run by each thread, or, unless par is set, a sequential one
+ * not using C, which DEBUG builds check the result against. */
+
+struct bdd::op_and_mt : op_and {
+	unordered_map<array<bdd_ref, 2>, bdd_ref> memo;
+	bool par = true;
+	bool leaf(frame& f, bdd_ref& r) const {
+		if (par && par_stop) return r = F, true;
+		if (canon(f, r)) return true;
+		auto it = memo.find({ f.x, f.y });
+		if (it != memo.end()) return r = PLUS_SHIFT(it->second, f.s), true;
+		if (par && C.peek(f.x, f.y, F, r))
+			return r = PLUS_SHIFT(r, f.s), true;
+		return false;
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) {
+		const bdd_ref r = par ? add_mt(f.v, h, l) : add(f.v, h, l);
+		memo.emplace(array<bdd_ref, 2>{ f.x, f.y }, r);
+		return PLUS_SHIFT(r, f.s);
+	}
+};
+
+bdd_ref bdd::bdd_and_par(bdd_ref x, bdd_ref y) {
+	// Whether x has at least par_min_nodes nodes, counting them up to that
+	static vector<uint32_t> seen;
+	static uint32_t stamp = 0;
+	auto large = [](bdd_ref x) {
+		if (seen.size() < V.size()) seen.resize(V.size());
+		if (!++stamp) fill(seen.begin(), seen.end(), 0), stamp = 1;
+		vector<bdd_id> s = { GET_BDD_ID(x) };
+		for (size_t k = 0; !s.empty(); ) {
+			const bdd_id id = s.back();
+			s.pop_back();
+			if (id < 2 || seen[id] == stamp) continue;
+			if (++k == par_min_nodes) return true;
+			seen[id] = stamp, s.push_back(GET_BDD_ID(V[id].h)),
+			s.push_back(GET_BDD_ID(V[id].l));
+		}
+		return false;
+	};
+	op_and op;
+	if (par_region || !(large(x) || large(y))) return apply(op, x, y);
+	// The top of the recursion in breadth first order, the frames from
+	// the first unexpanded one on being the subproblems
+	struct top { frame f; bdd_ref r; size_t h, l; bool done; };
+	vector<top> t = { { { x, y, 0 }, 0, 0, 0, false } };
+	size_t n = 0;
+	for (frame h, l; n != t.size() && t.size() - n < 4 * threads; ++n) {
+		if ((t[n].done = op.leaf(t[n].f, t[n].r))) continue;
+		op.split(t[n].f, h, l), t[n].h = t.size(), t[n].l = t.size() + 1;
+		t.push_back({ h, 0, 0, 0, false }), t.push_back({ l, 0, 0, 0, false });
+	}
+	const size_t top_size = n, subs = t.size() - n, n0 = V.size();
+	par_end = n0 + par_budget;
+#ifdef BDD_COMPACT_REFS
+	par_end = min(par_end, size_t(1) << BDD_ID_BITS);
 #endif
-	// Upshift result to obtain answer for pre-downshifted BDDs
-	return PLUS_SHIFT(r, min_shift);
+	if (subs > 1 && par_end > n0) {
+		par_next = n0, par_stop = false, par_region = true;
+		V.resize(par_end, bdd(0, 0));
+		if (B.size() < par_end)
+			B.resize(par_end), bdd_handle::R.resize(par_end, 0);
+		fill(B.begin() + n0, B.begin() + par_end, C.generation());
+		id_map.reserve(id_map.size() + par_end - n0), id_map.settle();
+		vector<op_and_mt> ops(threads);
+		atomic<size_t> next(0);
+		atomic<bool> failed(false);
+		exception_ptr e;
+		auto run = [&t, &ops, &next, &failed, &e, n, subs](size_t k) {
+			try {
+				for (size_t i; !par_stop && (i = next++) < subs; )
+					t[n + i].r = apply(ops[k], t[n + i].f.x,
+						t[n + i].f.y);
+			} catch (...) {
+				if (!failed.exchange(true)) e = current_exception();
+				par_stop = true;
+			}
+		};
+		vector<thread> ts;
+		for (size_t k = 1; k != threads; ++k) ts.emplace_back(run, k);
+		run(0);
+		for (thread& th : ts) th.join();
+		const size_t end = min(par_next.load(), par_end);
+		V.erase(V.begin() + end, V.end()), par_region = false;
+		fill(B.begin() + end, B.begin() + par_end, unborn);
+		for (size_t c = 0; c != C.capacity() &&
+			V.size() - FR.size() > C.capacity(); )
+			c = C.capacity(), C.grow();
+		if (e) rethrow_exception(e);
+		if (par_stop) return par_budget <<= 1, apply(op, x, y);
+		for (const op_and_mt& o : ops)
+			for (const auto& m : o.memo)
+				C.insert(m.first[0], m.first[1], F, m.second);
+	} else for (; n != t.size(); ++n) t[n].r = apply(op, t[n].f.x, t[n].f.y);
+	for (n = top_size; n--; )
+		if (!t[n].done)
+			t[n].r = op.join(t[n].f, t[t[n].h].r, t[t[n].l].r);
+	DBG(op_and_mt chk; chk.par = false;)
+	DBG(assert(t[0].r == apply(chk, x, y));)
+	return t[0].r;
 }
+#endif
 
 bdd_ref bdd::bdd_ite_var(bdd_shft x, bdd_ref y, bdd_ref z) {
-	if (x+1 < var(y) && x+1 < var(z)) return add(x+1, y, z);
+	// Terminals do not depend on any variable, so renames preserving the
+	// variable order come down to a single add per node
+	if ((leaf(y) || x+1 < var(y)) && (leaf(z) || x+1 < var(z)))
+		return add(x+1, y, z);
 	return bdd_ite(from_bit(x, true), y, z);
 }
 
 /* Compute x -> y, z from the given triple of BDDs. I.e. (x && y) || (~x && y). */
 
-bdd_ref bdd::bdd_ite(bdd_ref x, bdd_ref y, bdd_ref  z) {
-	DBG(assert(GET_BDD_ID(x) && GET_BDD_ID(y) && GET_BDD_ID(z));)
-	if (GET_INV_OUT(x)) return bdd_ite(FLIP_INV_OUT(x), z, y);
-	if (x == F) return z;
-	if (x == T || y == z) return y;
-	if (x == FLIP_INV_OUT(y) || x == z) return F;
-	if (y == T) return bdd_or(x, z);
-	if (y == F) return bdd_and(FLIP_INV_OUT(x), z);
-	if (z == F) return bdd_and(x, y);
-	if (z == T) return bdd_or(FLIP_INV_OUT(x), y);
-	// Downshift the input BDDs by their greatest common shift. Operate on this
-	// reduced form then upshift the result by the aforementioned shift. Intent is
-	// that this canonisation increases cache hits.
-	const bdd_shft min_shift = min(GET_SHIFT(x), min(GET_SHIFT(y), GET_SHIFT(z)));
-	DECR_SHIFT(x, min_shift);
-	DECR_SHIFT(y, min_shift);
-	DECR_SHIFT(z, min_shift);
-	auto it = C.find({x, y, z});
-	// If result in cache then upshift to obtain answer for pre-downshifted BDDs
-	if (it != C.end()) return PLUS_SHIFT(it->second, min_shift);
-	bdd_ref r;
-	const bdd bx = get(x), by = get(y), bz = get(z);
-	const bdd_shft xshift = GET_SHIFT(x), yshift = GET_SHIFT(y), zshift = GET_SHIFT(z);
-	if (xshift == yshift && yshift == zshift)
-		r =	add(xshift, bdd_ite(bx.h, by.h, bz.h),
-				bdd_ite(bx.l, by.l, bz.l));
-	else if (!xshift && !yshift)
-		r =	add(xshift, bdd_ite(bx.h, by.h, z),
-				bdd_ite(bx.l, by.l, z));
-	else if (!yshift && !zshift)
-		r =	add(yshift, bdd_ite(x, by.h, bz.h),
-				bdd_ite(x, by.l, bz.l));
-	else if (!xshift && !zshift)
-		r =	add(xshift, bdd_ite(bx.h, y, bz.h),
-				bdd_ite(bx.l, y, bz.l));
-	else if (!xshift)
-		r =	add(xshift, bdd_ite(bx.h, y, z), bdd_ite(bx.l, y, z));
-	else if (!yshift)
-		r =	add(yshift, bdd_ite(x, by.h, z), bdd_ite(x, by.l, z));
-	else	r =	add(zshift, bdd_ite(x, y, bz.h), bdd_ite(x, y, bz.l));
-	// Upshift result to obtain answer for pre-downshifted BDDs
-	if (C.size() > gclimit) return PLUS_SHIFT(r, min_shift);
-	return C.emplace(ite_memo{x, y, z}, r), PLUS_SHIFT(r, min_shift);
+struct bdd::op_ite {
+	bool leaf(frame& f, bdd_ref& r) const {
+		bdd_ref x = f.x, y = f.y, z = f.z;
+		DBG(assert(GET_BDD_ID(x) && GET_BDD_ID(y) && GET_BDD_ID(z));)
+		if (GET_INV_OUT(x)) x = FLIP_INV_OUT(x), swap(y, z);
+		if (x == F) return r = z, true;
+		if (x == T || y == z) return r = y, true;
+		if (x == FLIP_INV_OUT(y) || x == z) return r = F, true;
+		if (y == T) return r = bdd_or(x, z), true;
+		if (y == F) return r = bdd_and(FLIP_INV_OUT(x), z), true;
+		if (z == F) return r = bdd_and(x, y), true;
+		if (z == T) return r = bdd_or(FLIP_INV_OUT(x), y), true;
+		// Downshift the input BDDs by their greatest common shift. Operate
+		// on this reduced form then upshift the result by the aforementioned
+		// shift. Intent is that this canonisation increases cache hits.
+		const bdd_shft min_shift =
+			min(GET_SHIFT(x), min(GET_SHIFT(y), GET_SHIFT(z)));
+		DECR_SHIFT(x, min_shift);
+		DECR_SHIFT(y, min_shift);
+		DECR_SHIFT(z, min_shift);
+		// If result in cache then upshift to obtain answer for
+		// pre-downshifted BDDs
+		if (C.find(x, y, z, r)) return r = PLUS_SHIFT(r, min_shift), true;
+		return f.x = x, f.y = y, f.z = z, f.s = min_shift, false;
+	}
+	void split(frame& f, frame& h, frame& l) const {
+		const bdd_ref x = f.x, y = f.y, z = f.z;
+		const bdd bx = get(x), by = get(y), bz = get(z);
+		const bdd_shft xshift = GET_SHIFT(x), yshift = GET_SHIFT(y),
+			zshift = GET_SHIFT(z);
+		if (xshift == yshift && yshift == zshift)
+			f.v = xshift, h = { bx.h, by.h, bz.h },
+			l = { bx.l, by.l, bz.l };
+		else if (!xshift && !yshift)
+			f.v = xshift, h = { bx.h, by.h, z }, l = { bx.l, by.l, z };
+		else if (!yshift && !zshift)
+			f.v = yshift, h = { x, by.h, bz.h }, l = { x, by.l, bz.l };
+		else if (!xshift && !zshift)
+			f.v = xshift, h = { bx.h, y, bz.h }, l = { bx.l, y, bz.l };
+		else if (!xshift)
+			f.v = xshift, h = { bx.h, y, z }, l = { bx.l, y, z };
+		else if (!yshift)
+			f.v = yshift, h = { x, by.h, z }, l = { x, by.l, z };
+		else f.v = zshift, h = { x, y, bz.h }, l = { x, y, bz.l };
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) const {
+		const bdd_ref r = add(f.v, h, l);
+		// Upshift result to obtain answer for pre-downshifted BDDs
+		return C.insert(f.x, f.y, f.z, r), PLUS_SHIFT(r, f.s);
+	}
+};
+
+bdd_ref bdd::bdd_ite(bdd_ref x, bdd_ref y, bdd_ref z) {
+	op_ite op;
+	return apply(op, x, y, z);
+}
+
+/* Look up the conjunction of the given pair of BDDs in the computed table
+ * without computing it. Applies the same canonisation as bdd_and. */
+
+bool bdd::bdd_and_cached(bdd_ref x, bdd_ref y, bdd_ref& r) {
+	if (BDD_LT(y, x)) swap(x, y);
+	const bdd_shft min_shift = min(GET_SHIFT(x), GET_SHIFT(y));
+	if (!C.find(MINUS_SHIFT(x, min_shift), MINUS_SHIFT(y, min_shift), F, r))
+		return false;
+	return r = PLUS_SHIFT(r, min_shift), true;
 }
 
 void am_sort(bdds& b) {
@@ -322,18 +695,14 @@ bool subset(const bdds& small, const bdds& big) {
 
 bdd_ref bdd::bdd_and_many(bdds v) {
 #ifdef MEMO
-	static unordered_map<ite_memo, bdd_ref>::const_iterator jt;
+	bdd_ref r;
 	for (size_t n = 0; n < v.size(); ++n)
-		for (size_t k = 0; k < n; ++k) {
-			bdd_ref x, y;
-			if (v[n] < v[k]) x = v[n], y = v[k];
-			else x = v[k], y = v[n];
-			if ((jt = C.find({x, y, F})) != C.end()) {
+		for (size_t k = 0; k < n; ++k)
+			if (bdd_and_cached(v[k], v[n], r)) {
 				v.erase(v.begin()+k), v.erase(v.begin()+n-1),
-				v.push_back(jt->second), n = k = 0;
+				v.push_back(r), n = k = 0;
 				break;
 			}
-		}
 #endif
 	if (v.empty()) return T;
 	if (v.size() == 1) return v[0];
@@ -359,37 +728,104 @@ bdd_ref bdd::bdd_and_many(bdds v) {
 	return AM.emplace(v, bdd::add(m, h, l)).first->second;
 }
 
+/* Sort the given disjuncts and drop duplicates and F from them. Collapse them
+ * to {T} if one of them is T or two of them are complementary. */
+
+void or_sort(bdds& b) {
+	sort(b.begin(), b.end(), am_cmp);
+	size_t k = 0;
+	for (size_t n = 0; n != b.size(); ++n)
+		if (b[n] == T || (k && b[n] == FLIP_INV_OUT(b[k-1]))) {
+			b = {T};
+			return;
+		} else if (b[n] != F && !(k && b[n] == b[k-1])) b[k++] = b[n];
+	b.resize(k);
+}
+
+/* Compute (t | a_0 | ... | a_N) & ~(d_0 | ... | d_M) in a single simultaneous
+ * recursion over all the operands instead of reducing each side separately. */
+
+bdd_ref bdd::bdd_update(bdd_ref t, bdds a, bdds d,
+	unordered_map<bdds, bdd_ref>& memo)
+{
+	or_sort(a), or_sort(d);
+	if (!d.empty() && d[0] == T) return F;
+	if (d.empty()) return a.push_back(t), bdd_or_reduce(move(a));
+	bdd_ref r;
+	if (t == T || (!a.empty() && a[0] == T))
+		return r = bdd_or_reduce(move(d)), FLIP_INV_OUT(r);
+	// Disjuncts that are also deleted do not contribute
+	for (size_t n = 0; n < a.size();)
+		if (hasbc(d, a[n], am_cmp)) a.erase(a.begin() + n);
+		else ++n;
+	if (a.empty())
+		return r = bdd_or_reduce(move(d)), bdd_and(t, FLIP_INV_OUT(r));
+	// Key the memo on a and d separated by the never referenced BDD ID 0
+	bdds k(a);
+	k.push_back(0), k.insert(k.end(), d.begin(), d.end()), k.push_back(t);
+	auto it = memo.find(k);
+	if (it != memo.end()) return it->second;
+	bdd_shft m = leaf(t) ? bdd_shft(-1) : var(t);
+	for (bdd_ref x : a) m = min(m, var(x));
+	for (bdd_ref x : d) m = min(m, var(x));
+	bdds ah, al, dh, dl;
+	ah.reserve(a.size()), al.reserve(a.size());
+	dh.reserve(d.size()), dl.reserve(d.size());
+	for (bdd_ref x : a)
+		if (var(x) != m) ah.push_back(x), al.push_back(x);
+		else ah.push_back(hi(x)), al.push_back(lo(x));
+	for (bdd_ref x : d)
+		if (var(x) != m) dh.push_back(x), dl.push_back(x);
+		else dh.push_back(hi(x)), dl.push_back(lo(x));
+	const bool tm = !leaf(t) && var(t) == m;
+	const bdd_ref h = bdd_update(tm ? hi(t) : t, move(ah), move(dh), memo),
+		l = bdd_update(tm ? lo(t) : t, move(al), move(dl), memo);
+	return memo.emplace(move(k), add(m, h, l)).first->second;
+}
+
+/* Compute exists ex (x & y), renamed according to p unless it is null. The
+ * variables after last + 1 are neither quantified nor moved. */
+
+struct bdd::op_and_ex {
+	const bools& ex;
+	const bdd_shfts* p;
+	unordered_map<array<bdd_ref, 2>, bdd_ref>& memo;
+	unordered_map<bdd_ref, bdd_ref>& m2;
+	bdd_shft last;
+	bdd_ref unary(bdd_ref x) const {
+		return p ? bdd_permute_ex(x, ex, *p, last, m2)
+			: bdd_ex(x, ex, m2, last);
+	}
+	bool leaf(frame& f, bdd_ref& r) const {
+		bdd_ref x = f.x, y = f.y;
+		DBG(assert(GET_BDD_ID(x) && GET_BDD_ID(y));)
+		if (x == F || y == F || x == FLIP_INV_OUT(y)) return r = F, true;
+		if (x == T || x == y) return r = unary(y), true;
+		if (y == T) return r = unary(x), true;
+		if (x > y) swap(x, y);
+		const array<bdd_ref, 2> m = { x, y };
+		auto it = memo.find(m);
+		if (it != memo.end()) return r = it->second, true;
+		if (GET_SHIFT(x) > last+1 && GET_SHIFT(y) > last+1)
+			return memo.emplace(m, r = bdd_and(x, y)), true;
+		return f.x = x, f.y = y, false;
+	}
+	void split(frame& f, frame& h, frame& l) const {
+		op_and().split(f, h, l);
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) const {
+		DBG(assert((size_t)f.v - 1 < ex.size());)
+		const bdd_ref r = ex[f.v - 1] ? bdd_or(h, l) : p ?
+			bdd_ite_var((*p)[f.v - 1], h, l) : add(f.v, h, l);
+		return memo.emplace(array<bdd_ref, 2>{ f.x, f.y }, r), r;
+	}
+};
+
 bdd_ref bdd::bdd_and_ex(bdd_ref x, bdd_ref y, const bools& ex,
 	unordered_map<array<bdd_ref, 2>, bdd_ref>& memo,
 	unordered_map<bdd_ref, bdd_ref>& m2, bdd_shft last) {
-	DBG(assert(GET_BDD_ID(x) && GET_BDD_ID(y));)
-	if (x == F || y == F || x == FLIP_INV_OUT(y)) return F;
-	if (x == T || x == y) return bdd_ex(y, ex, m2, last);
-	if (y == T) return bdd_ex(x, ex, m2, last);
-	if (x > y) swap(x, y);
-	array<bdd_ref, 2> m = {x, y};
-	auto it = memo.find(m);
-	if (it != memo.end()) return it->second;
-	const bdd bx = get(x), by = get(y);
-	bdd_shft v;
-	bdd_ref rx, ry, r;
-	if (GET_SHIFT(x) > last+1 && GET_SHIFT(y) > last+1)
-		return memo.emplace(m, r = bdd_and(x, y)), r;
-	if (GET_SHIFT(x) < GET_SHIFT(y))
-		v = GET_SHIFT(x),
-		rx = bdd_and_ex(bx.h, y, ex, memo, m2, last),
-		ry = bdd_and_ex(bx.l, y, ex, memo, m2, last);
-	else if (GET_SHIFT(x) > GET_SHIFT(y))
-		v = GET_SHIFT(y),
-		rx = bdd_and_ex(x, by.h, ex, memo, m2, last),
-		ry = bdd_and_ex(x, by.l, ex, memo, m2, last);
-	else
-		v = GET_SHIFT(x),
-		rx = bdd_and_ex(bx.h, by.h, ex, memo, m2, last),
-		ry = bdd_and_ex(bx.l, by.l, ex, memo, m2, last);
-	DBG(assert((size_t)v - 1 < ex.size());)
-	r = ex[v - 1] ? bdd_or(rx, ry) : add(v, rx, ry);
-	return memo.emplace(m, r), r;
+	op_and_ex op{ ex, 0, memo, m2, last };
+	return apply(op, x, y);
 }
 
 struct sbdd_and_ex_perm {
@@ -399,52 +835,62 @@ struct sbdd_and_ex_perm {
 	unordered_map<bdd_ref, bdd_ref>& m2;
 	bdd_shft last;
 
-	sbdd_and_ex_perm(const bools& ex, const bdd_shfts& p,
+	sbdd_and_ex_perm(const bools& ex, const bdd_shfts& p, bdd_shft last,
 	unordered_map<array<bdd_ref, 2>, bdd_ref>& memo,
 	unordered_map<bdd_ref, bdd_ref>& m2) :
-		ex(ex), p(p), memo(memo), m2(m2), last(0) {
-			for (size_t n = 0; n != ex.size(); ++n)
-				if (ex[n] || (p[n] != n)) last = n;
-		}
+		ex(ex), p(p), memo(memo), m2(m2), last(last) {}
 
 	bdd_ref operator()(bdd_ref x, bdd_ref y) {
-		DBG(assert(GET_BDD_ID(x) && GET_BDD_ID(y));)
-		if (x == F || y == F || x == FLIP_INV_OUT(y)) return F;
-		if (x == T || x == y)
-			return bdd::bdd_permute_ex(y, ex, p, last, m2);
-		if (y == T) return bdd::bdd_permute_ex(x, ex, p, last, m2);
-		if (x > y) swap(x, y);
-		array<bdd_ref, 2> m = {x, y};
-		auto it = memo.find(m);
-		if (it != memo.end()) return it->second;
-		const bdd bx = bdd::get(x), by = bdd::get(y);
-		bdd_shft v;
-		bdd_ref rx, ry, r;
-		if (GET_SHIFT(x) > last+1 && GET_SHIFT(y) > last+1)
-			return memo.emplace(m, r = bdd::bdd_and(x, y)), r;
-		if (GET_SHIFT(x) < GET_SHIFT(y))
-			v = GET_SHIFT(x), rx = (*this)(bx.h, y), ry = (*this)(bx.l, y);
-		else if (GET_SHIFT(x) > GET_SHIFT(y))
-			v = GET_SHIFT(y), rx = (*this)(x, by.h), ry = (*this)(x, by.l);
-		else v = GET_SHIFT(x), rx = (*this)(bx.h,by.h), ry = (*this)(bx.l,by.l);
-		DBG(assert((size_t)v - 1 < ex.size());)
-		r = ex[v - 1] ? bdd::bdd_or(rx, ry) :
-			bdd::bdd_ite_var(p[v-1], rx, ry);
-		return memo.emplace(m, r), r;
+		bdd::op_and_ex op{ ex, &p, memo, m2, last };
+		return bdd::apply(op, x, y);
 	}
 };
 
+size_t bdd_op_id(const bools& ex, const bdd_shfts& p) {
+	size_t h = hash<bdd_shfts>()(p);
+	for (size_t n = 0; n != ex.size(); ++n)
+		h ^= ex[n] + 0x9e3779b9 + (h << 6) + (h >> 2);
+	vector<size_t>& ids = OH[h];
+	for (size_t id : ids) if (O[id].ex == ex && O[id].p == p) return id;
+	return ids.push_back(O.size()), O.emplace_back(ex, p), O.size() - 1;
+}
+
+/* The ID of the operation quantifying the variables of op without renaming
+ * them. */
+
+size_t ex_op(size_t op) {
+	ex_perm_op& o = O[op];
+	if (o.exop == SIZE_MAX) o.exop = bdd_op_id(o.ex, {});
+	return o.exop;
+}
+
 bdd_ref bdd::bdd_and_ex(bdd_ref x, bdd_ref  y, const bools& ex) {
-	bdd_shft last = 0;
-	for (bdd_shft n = 0; n != ex.size(); ++n) if (ex[n]) last = n;
-	bdd_ref r = bdd_and_ex(x, y, ex, CX[ex], memos_ex[ex], last);
-	DBG(bdd_ref t = bdd_ex(bdd_and(x, y), ex);)
+	return bdd_and_ex(x, y, bdd_op_id(ex, {}));
+}
+
+bdd_ref bdd::bdd_and_ex(bdd_ref x, bdd_ref y, size_t op) {
+	ex_perm_op& o = O[op];
+	DBG(assert(o.p.empty());)
+	bdd_ref r = bdd_and_ex(x, y, o.ex, o.m2, o.m1, o.last);
+	DBG(bdd_ref t = bdd_ex(bdd_and(x, y), o.ex);)
 	DBG(assert(r == t);)
 	return r;
 }
 
 bdd_ref bdd::bdd_and_ex_perm(bdd_ref x, bdd_ref  y, const bools& ex, const bdd_shfts& p) {
-	return sbdd_and_ex_perm(ex,p,CXP[{ex,p}],memos_perm_ex[{p,ex}])(x,y);
+	return bdd_and_ex_perm(x, y, bdd_op_id(ex, p));
+}
+
+bdd_ref bdd::bdd_and_ex_perm(bdd_ref x, bdd_ref y, size_t op) {
+	ex_perm_op& o = O[op];
+	if (shiftable(x, op) && shiftable(y, op)) {
+		bdd_ref r = o.quant ? bdd_and_ex(x, y, ex_op(op)) : bdd_and(x, y);
+		r = ex_perm_shift(r, op);
+		DBG(assert(r == sbdd_and_ex_perm(o.ex, o.p, o.last, o.m2, o.m1)(
+			x, y));)
+		return r;
+	}
+	return sbdd_and_ex_perm(o.ex, o.p, o.last, o.m2, o.m1)(x, y);
 }
 
 char bdd::bdd_and_many_ex_iter(const bdds& v, bdds& h, bdds& l, bdd_shft& m) {
@@ -544,14 +990,11 @@ struct sbdd_and_many_ex_perm {
 	sbdd_and_ex_perm saep;
 
 	sbdd_and_many_ex_perm(const bools& ex, const bdd_shfts& p,
-		unordered_map<bdds, bdd_ref>& memo,
+		bdd_shft last, unordered_map<bdds, bdd_ref>& memo,
 		unordered_map<array<bdd_ref, 2>, bdd_ref>& m2,
 		unordered_map<bdd_ref, bdd_ref>& m3) :
-		ex(ex), p(p), memo(memo), m2(m2), m3(m3), last(0),
-		saep(ex, p, m2, m3) {
-			for (size_t n = 0; n != ex.size(); ++n)
-				if (ex[n] || (p[n] != n)) last = n;
-		}
+		ex(ex), p(p), memo(memo), m2(m2), m3(m3), last(last),
+		saep(ex, p, last, m2, m3) {}
 
 	bdd_ref operator()(bdds v) {
 		if (v.empty()) return T;
@@ -598,184 +1041,200 @@ struct sbdd_and_many_ex_perm {
 };
 
 bdd_ref bdd::bdd_and_many_ex(bdds v, const bools& ex) {
+	ex_perm_op& o = O[bdd_op_id(ex, {})];
 	bdd_ref r;
 	DBG(bdd_ref t = bdd_ex(bdd_and_many(v), ex);)
-	r = sbdd_and_many_ex(ex, AMX[ex], memos_ex[ex], CX[ex])(v);
+	r = sbdd_and_many_ex(ex, o.mn, o.m1, o.m2)(v);
 	DBG(assert(r == t);)
 	return r;
 }
 
 bdd_ref bdd::bdd_and_many_ex_perm(bdds v, const bools& ex, const bdd_shfts& p) {
-	return sbdd_and_many_ex_perm(ex, p, AMXP[{ex,p}], CXP[{ex,p}],
-			memos_perm_ex[{p,ex}])(v);
+	return bdd_and_many_ex_perm(move(v), bdd_op_id(ex, p));
+}
+
+bdd_ref bdd::bdd_and_many_ex_perm(bdds v, size_t op) {
+	if (v.size() >= 4) return bdd_and_many_sched(move(v), op);
+	ex_perm_op& o = O[op];
+	bool shift = o.uniform;
+	for (size_t n = 0; shift && n != v.size(); ++n)
+		shift = shiftable(v[n], op);
+	if (shift) {
+		DBG(const bdds w = v;)
+		bdd_ref r = o.quant ? bdd_and_many_ex(move(v), o.ex)
+			: bdd_and_many(move(v));
+		r = ex_perm_shift(r, op);
+		DBG(assert(r == sbdd_and_many_ex_perm(o.ex, o.p, o.last, o.mn,
+			o.m2, o.m1)(w));)
+		return r;
+	}
+	return sbdd_and_many_ex_perm(o.ex, o.p, o.last, o.mn, o.m2, o.m1)(
+		move(v));
+}
+
+/* Mark in s the variables the given BDD depends on. Visited references are
+ * kept in seen, whose size ends up being the number of nodes reached. */
+
+void bdd::bdd_support(bdd_ref x, bools& s, unordered_set<bdd_ref>& seen) {
+	if (leaf(x) || !seen.insert(BDD_ABS(x)).second) return;
+	const bdd_shft v = var(x);
+	if (s.size() < v) s.resize(v);
+	s[v - 1] = true, bdd_support(hi(x), s, seen), bdd_support(lo(x), s, seen);
+}
+
+/* Conjoin the given BDDs and apply the quantification and permutation of op
+ * to the result, consuming the conjuncts one at a time in the spirit of the
+ * IWLS95 scheduler. A variable to be quantified is quantified out of the
+ * running product as soon as the last conjunct depending on it has been
+ * conjoined instead of at the bottom of one n-ary recursion over all of them,
+ * which keeps the intermediate products small. The next conjunct is picked
+ * greedily as the one adding the fewest new variables to the product net of
+ * the ones it lets quantify out, and the smaller one among equals. The
+ * permutation is applied along with the last conjunction. */
+
+bdd_ref bdd::bdd_and_many_sched(bdds v, size_t op) {
+	const bools& ex = O[op].ex;
+	const size_t n = v.size();
+	vector<bools> sup(n);
+	vector<size_t> sz(n), cnt(ex.size());
+	for (size_t i = 0; i != n; ++i) {
+		unordered_set<bdd_ref> seen;
+		bdd_support(v[i], sup[i], seen), sz[i] = seen.size();
+		for (size_t k = 0; k != min(sup[i].size(), ex.size()); ++k)
+			cnt[k] += sup[i][k];
+	}
+	// in marks the variables of the product r, e those quantified so far
+	bools in, e(ex.size()), used(n);
+	bdd_ref r = T;
+	for (size_t step = 0; step + 1 != n; ++step) {
+		size_t best = n;
+		int_t bcost = 0;
+		for (size_t i = 0; i != n; ++i) {
+			if (used[i]) continue;
+			int_t cost = 0;
+			for (size_t k = 0; k != sup[i].size(); ++k)
+				if (!sup[i][k]) continue;
+				else if (k < ex.size() && ex[k] && cnt[k] == 1) --cost;
+				else if (k >= in.size() || !in[k]) ++cost;
+			if (best == n || cost < bcost ||
+				(cost == bcost && sz[i] < sz[best]))
+				best = i, bcost = cost;
+		}
+		const bools& s = sup[best];
+		bool q = false;
+		used[best] = true;
+		if (in.size() < s.size()) in.resize(s.size());
+		for (size_t k = 0; k != s.size(); ++k)
+			if (!s[k]) continue;
+			else if (in[k] = true, k < ex.size() && ex[k] && !--cnt[k])
+				e[k] = q = true, in[k] = false;
+		r = q ? bdd_and_ex(r, v[best], e) : bdd_and(r, v[best]);
+		if (r == F) break;
+	}
+	for (size_t i = 0; r != F && i != n; ++i)
+		if (!used[i]) { r = bdd_and_ex_perm(r, v[i], op); break; }
+	DBG(ex_perm_op& o = O[op];)
+	DBG(assert(r == sbdd_and_many_ex_perm(o.ex, o.p, o.last, o.mn, o.m2,
+		o.m1)(v));)
+	return r;
 }
 
+/* Mark in S the BDD of i and every BDD reachable from it. Runs over the
+ * explicit stack SM rather than recursing once per variable, so collecting
+ * BDDs over many variables cannot overflow the call stack. */
+
 void bdd::mark_all(bdd_ref i) {
 	DBG(assert((size_t)GET_BDD_ID(i) < V.size());)
-	if (GET_BDD_ID(i) >= 2 && !has(S, GET_BDD_ID(i)))
-		mark_all(hi(i)), mark_all(lo(i)), S.insert(GET_BDD_ID(i));
+	for (SM.push_back(GET_BDD_ID(i)); !SM.empty();) {
+		const bdd_id id = SM.back();
+		SM.pop_back();
+		if (id < 2 || S[id]) continue;
+		S[id] = true;
+		SM.push_back(GET_BDD_ID(V[id].h)), SM.push_back(GET_BDD_ID(V[id].l));
+	}
 }
 
 /* Get the size of the ITE cache. */
 size_t bdd::get_ite_cache_size() { return C.size(); }
 /* Only trigger the garbage collector when given limit is exceeded */
-void bdd::set_gc_limit(size_t new_gc_limit) { gclimit = new_gc_limit; }
+void bdd::set_gc_limit(size_t new_gc_limit) {
+	gc_next = gclimit = new_gc_limit;
+}
 /* Enable/disable the garbage collector depending on given argument */
 void bdd::set_gc_enabled(bool new_gc_enabled) { gc_enabled = new_gc_enabled; }
 
 template <typename T>
 basic_ostream<T>& bdd::stats(basic_ostream<T>& os) {
-	return os << "# S: " << S.size() << " V: "<< V.size() <<
+	return os << "# free: " << FR.size() << " V: "<< V.size() <<
 		" AM: " << AM.size() << " C: "<< C.size();
 }
 template basic_ostream<char>& bdd::stats(basic_ostream<char>&);
 template basic_ostream<wchar_t>& bdd::stats(basic_ostream<wchar_t>&);
 
-void bdd::gc() {
-	if(!gc_enabled) return;
-	if (V.empty()) return;
-	S.clear();
-	for (auto x : bdd_handle::M) mark_all(x.first);
-//	if (V.size() < S.size() << 3) return;
-	id_map.clear(), S.insert(0), S.insert(1);
-//	if (S.size() >= 1e+6) { COUT << "out of memory" << endl; exit(1); }
-	vector<bdd_id> p(V.size(), 0);
-#ifndef NOMMAP
-	bdd_mmap v1(memory_map_allocator<bdd>("", bdd_mmap_mode));
-	v1.reserve(bdd_mmap_mode == MMAP_NONE ? S.size() : max_bdd_nodes);
-#else
-	bdd_mmap v1;
-	v1.reserve(S.size());
-#endif
-	for (size_t n = 0; n < V.size(); ++n)
-		if (has(S, n)) p[n] = v1.size(), v1.emplace_back(move(V[n]));
-	//OUT(stats(COUT)<<endl;)
-	V = move(v1);
-#define f(i) (SET_BDD_ID(i, (p[GET_BDD_ID(i)] ? p[GET_BDD_ID(i)] : GET_BDD_ID(i))), i)
-	for (size_t n = 2; n < V.size(); ++n) {
-		DBG(assert(p[GET_BDD_ID(V[n].h)] && p[GET_BDD_ID(V[n].l)]);)
-		f(V[n].h), f(V[n].l);
-	}
-	unordered_map<ite_memo, bdd_ref> c;
-	unordered_map<bdds, bdd_ref> am;
-	for (pair<ite_memo, bdd_ref> x : C)
-		if (	has(S, GET_BDD_ID(x.first.x)) &&
-			has(S, GET_BDD_ID(x.first.y)) &&
-			has(S, GET_BDD_ID(x.first.z)) &&
-			has(S, GET_BDD_ID(x.second)))
-			f(x.first.x), f(x.first.y), f(x.first.z),
-			x.first.rehash(), c.emplace(x.first, f(x.second));
-	C = move(c);
-	map<bools, unordered_map<array<bdd_ref, 2>, bdd_ref>, veccmp<bool>> cx;
-	unordered_map<array<bdd_ref, 2>, bdd_ref> cc;
-	for (const auto& x : CX) {
-		for (pair<array<bdd_ref, 2>, bdd_ref> y : x.second)
-			if (	has(S, GET_BDD_ID(y.first[0])) &&
-				has(S, GET_BDD_ID(y.first[1])) &&
-				has(S, GET_BDD_ID(y.second)))
-				f(y.first[0]), f(y.first[1]),
-				cc.emplace(y.first, f(y.second));
-		if (!cc.empty()) cx.emplace(x.first, move(cc));
-	}
-	CX = move(cx);
-	map<pair<bools, bdd_shfts>, unordered_map<array<bdd_ref, 2>, bdd_ref>,
-		vec2cmp<bool, bdd_shft>> cxp;
-	for (const auto& x : CXP) {
-		for (pair<array<bdd_ref, 2>, bdd_ref> y : x.second)
-			if (	has(S, GET_BDD_ID(y.first[0])) &&
-				has(S, GET_BDD_ID(y.first[1])) &&
-				has(S, GET_BDD_ID(y.second)))
-				f(y.first[0]), f(y.first[1]),
-				cc.emplace(y.first, f(y.second));
-		if (!cc.empty()) cxp.emplace(x.first, move(cc));
-	}
-	CXP = move(cxp);
-	unordered_map<bdd_ref, bdd_ref> q;
-	map<bools, unordered_map<bdd_ref, bdd_ref>, veccmp<bool>> mex;
-	for (const auto& x : memos_ex) {
-		for (pair<bdd_ref, bdd_ref> y : x.second)
-			if (has(S, GET_BDD_ID(y.first)) && has(S, GET_BDD_ID(y.second)))
-				q.emplace(f(y.first), f(y.second));
-		if (!q.empty()) mex.emplace(x.first, move(q));
-	}
-	memos_ex = move(mex);
-	map<bdd_shfts, unordered_map<bdd_ref, bdd_ref>, veccmp<bdd_shft>> mp;
-	for (const auto& x : memos_perm) {
-		for (pair<bdd_ref, bdd_ref> y : x.second)
-			if (has(S, GET_BDD_ID(y.first)) && has(S, GET_BDD_ID(y.second)))
-				q.emplace(f(y.first), f(y.second));
-		if (!q.empty()) mp.emplace(x.first, move(q));
-	}
-	memos_perm = move(mp);
-	map<pair<bdd_shfts, bools>, unordered_map<bdd_ref, bdd_ref>,
-		vec2cmp<bdd_shft, bool>> mpe;
-	for (const auto& x : memos_perm_ex) {
-		for (pair<bdd_ref, bdd_ref> y : x.second)
-			if (has(S, GET_BDD_ID(y.first)) && has(S, GET_BDD_ID(y.second)))
-				q.emplace(f(y.first), f(y.second));
-		if (!q.empty()) mpe.emplace(x.first, move(q));
-	}
-	memos_perm_ex = move(mpe);
-	bool b;
-	map<bools, unordered_map<bdds, bdd_ref>, veccmp<bool>> amx;
-	for (const auto& x : AMX) {
-		for (pair<bdds, bdd_ref> y : x.second) {
-			b = false;
-			for (bdd_ref& i : y.first)
-				if ((b |= !has(S, GET_BDD_ID(i)))) break;
-				else f(i);
-			if (!b && has(S, GET_BDD_ID(y.second)))
-				am.emplace(y.first, f(y.second));
-		}
-		if (!am.empty()) amx.emplace(x.first, move(am));
-	}
-	AMX = move(amx);
-	map<pair<bools, bdd_shfts>, unordered_map<bdds, bdd_ref>,
-		vec2cmp<bool, bdd_shft>> amxp;
-	for (const auto& x : AMXP) {
-		for (pair<bdds, bdd_ref> y : x.second) {
-			b = false;
-			for (bdd_ref& i : y.first)
-				if ((b |= !has(S, GET_BDD_ID(i)))) break;
-				else f(i);
-			if (!b && has(S, GET_BDD_ID(y.second)))
-				am.emplace(y.first, f(y.second));
-		}
-		if (!am.empty()) amxp.emplace(x.first, move(am));
-	}
-	AMXP = move(amxp);
-	for (pair<bdds, bdd_ref> x : AM) {
-		b = false;
-		for (bdd_ref& i : x.first)
-			if ((b |= !has(S, GET_BDD_ID(i)))) break;
-			else f(i);
-		if (!b&&has(S,GET_BDD_ID(x.second))) am.emplace(x.first, f(x.second));
-	}
-	AM=move(am), bdd_handle::update(p);
-	p.clear(), S.clear();
-	std::hash<bdd_ref> hsh;
-	for (size_t n = 0; n < V.size(); ++n)
-		id_map.emplace(bdd_key(hash_upair(hsh(V[n].h), hsh(V[n].l)),
-			V[n].h, V[n].l), n);
-	//OUT(COUT <<"# AM: " << AM.size() << " C: "<< C.size() << endl;)
+/* Check whether the given memo entry mentions a BDD that did not survive the
+ * marking phase of the garbage collector. */
+
+bool dead(bdd_ref x) { return !S[GET_BDD_ID(x)]; }
+bool dead(const array<bdd_ref, 2>& x) { return dead(x[0]) || dead(x[1]); }
+bool dead(const bdds& x) {
+	for (bdd_ref i : x) if (dead(i)) return true;
+	return false;
+}
+
+/* Erase the entries of the given memo that mention dead BDDs. Since the
+ * garbage collector does not move live BDDs, the surviving entries stay valid
+ * as they are. */
+
+template <typename M> void sweep(M& m) {
+	erase_if(m, [](const auto& x) { return dead(x.first) || dead(x.second); });
 }
 
-void bdd_handle::update(const vector<bdd_id>& p) {
-	unordered_map<bdd_ref, weak_ptr<bdd_handle>> m;
-	for (pair<bdd_ref, weak_ptr<bdd_handle>> x : M)
-		//DBG(assert(!x.second.expired());) // is this needed?
-		if (!x.second.expired())
-			f(x.second.lock()->b), m.emplace(f(x.first), x.second);
-	M = move(m);
+template <typename M> void sweep_all(M& m) {
+	for (auto it = m.begin(); it != m.end();)
+		if (sweep(it->second), it->second.empty()) it = m.erase(it);
+		else ++it;
 }
-#undef f
+
+/* Free every BDD that is not reachable from a live handle. Live BDDs keep their
+ * IDs, so handles and memo entries referring to them need no remapping, and the
+ * freed IDs are recycled by bdd::add. Memos keyed on whole BDD vectors are swept
+ * of dead entries in place while the computed table is left to validate its
+ * entries against the BDD generations lazily upon lookup. */
+
+void bdd::gc() {
+	if(!gc_enabled) return;
+	if (V.empty()) return;
+	S.assign(V.size(), false), S[0] = S[1] = true;
+	for (bdd_id id = 2; id < V.size(); ++id)
+		if (bdd_handle::R[id]) mark_all(BDD_REF(id, 0, false, false));
+	// Drop the dead tail of the node store and recycle the dead IDs below it
+	size_t n = V.size();
+	while (n > 2 && !S[n - 1]) --n;
+	V.erase(V.begin() + n, V.end()), FR.clear();
+	for (bdd_id id = n; id < B.size(); ++id) B[id] = unborn;
+	for (bdd_id id = n; id-- > 2;)
+		if (!S[id]) V[id] = bdd(0, 0), B[id] = unborn, FR.push_back(id);
+	id_map.clear(), id_map.reserve(V.size() - FR.size());
+	for (bdd_id id = 0, k; id < V.size(); ++id)
+		if (S[id]) id_map.find_or_insert(V[id].h, V[id].l, k = id);
+	for (ex_perm_op& o : O)
+		sweep(o.m1), sweep(o.m2), sweep(o.mn), sweep(o.mp), sweep(o.mw);
+	sweep(AM);
+	C.next_generation(), S.clear();
+	gc_next = max(gclimit, (V.size() - FR.size()) << 1);
+}
+
+/* Collect garbage once the number of live BDDs reaches twice the number that
+ * survived the previous collection, but not before it reaches gclimit. Must
+ * only be called when every BDD in use is held by a handle, for instance in
+ * between steps. */
+
+void bdd::gc_check() { if (V.size() - FR.size() >= gc_next) gc(); }
 
 spbdd_handle bdd_handle::get(bdd_ref  b) {
 	DBG(assert((size_t)GET_BDD_ID(b) < V.size());)
-	auto it = M.find(b);
-	if (it != M.end()) return it->second.lock();
-	spbdd_handle h(new bdd_handle(b));
-	return M.emplace(b, weak_ptr<bdd_handle>(h)), h;
+	spbdd_handle h;
+	return h.b = b, h.incr(), h;
 }
 
 void bdd::bdd_sz(bdd_ref x, set<bdd_ref>& s) {
@@ -814,7 +1273,7 @@ spbdd_handle bdd_ite_var(bdd_shft x, cr_spbdd_handle y, cr_spbdd_handle z) {
 }
 
 spbdd_handle bdd_and_many(bdd_handles v) {
-	if (V.size() >= gclimit) bdd::gc();
+	bdd::gc_check();
 /*	if (v.size() > 16) {
 		bdd_handles x, y;
 		spbdd_handle r;
@@ -835,7 +1294,7 @@ spbdd_handle bdd_and_many(bdd_handles v) {
 }
 
 spbdd_handle bdd_and_many_ex(bdd_handles v, const bools& ex) {
-	if (V.size() >= gclimit) bdd::gc();
+	bdd::gc_check();
 	bool t = false;
 	for (bool x : ex) t |= x;
 	if (!t) return bdd_and_many(move(v));
@@ -849,7 +1308,7 @@ spbdd_handle bdd_and_many_ex(bdd_handles v, const bools& ex) {
 
 spbdd_handle bdd_and_many_ex_perm(bdd_handles v, const bools& ex,
 	const bdd_shfts& p) {
-	if (V.size() >= gclimit) bdd::gc();
+	bdd::gc_check();
 //	DBG(assert(bdd_nvars(v) < ex.size());)
 //	DBG(assert(bdd_nvars(v) < p.size());)
 	bdds b;
@@ -860,6 +1319,15 @@ spbdd_handle bdd_and_many_ex_perm(bdd_handles v, const bools& ex,
 	return r;
 }
 
+spbdd_handle bdd_and_many_ex_perm(bdd_handles v, size_t op) {
+	bdd::gc_check();
+	bdds b;
+	b.reserve(v.size());
+	for (size_t n = 0; n != v.size(); ++n) b.push_back(v[n]->b);
+	am_sort(b);
+	return bdd_handle::get(bdd::bdd_and_many_ex_perm(move(b), op));
+}
+
 bdd_ref bdd_or_reduce(bdds b) {
 	if (b.empty()) return F;
 	if (b.size() == 1) return b[0];
@@ -884,6 +1352,25 @@ spbdd_handle bdd_or_many(bdd_handles v) {
 	return bdd_handle::get(FLIP_INV_OUT(bdd::bdd_and_many(move(b))));*/
 }
 
+/* Compute the database t updated with the insertions a and the deletions d.
+ * Fails if the same BDD is both inserted and deleted. */
+
+bool bdd_update(cr_spbdd_handle t, bdd_handles a, bdd_handles d,
+	spbdd_handle& r)
+{
+	bdds ba(a.size()), bd(d.size());
+	for (size_t n = 0; n != a.size(); ++n) ba[n] = a[n]->b;
+	for (size_t n = 0; n != d.size(); ++n) bd[n] = d[n]->b;
+	sort(ba.begin(), ba.end()), sort(bd.begin(), bd.end());
+	for (auto ia = ba.begin(), id = bd.begin(); ia != ba.end() && id != bd.end();)
+		if (*ia < *id) ++ia;
+		else if (*id < *ia) ++id;
+		else return false;
+	unordered_map<bdds, bdd_ref> memo;
+	return r = bdd_handle::get(bdd::bdd_update(t->b, move(ba), move(bd), memo)),
+		true;
+}
+
 spbdd_handle from_high(bdd_shft s, bdd_ref x) {
 	return bdd_handle::get(bdd::add(s + 1, x, F));
 }
@@ -896,6 +1383,92 @@ spbdd_handle from_high_and_low(bdd_shft s, bdd_ref x, bdd_ref y) {
 	return bdd_handle::get(bdd::add(s + 1, x, y));
 }
 
+/* Build the BDD of the n sorted and distinct keys at k in a single pass over
+ * them. The nodes on the path of the last key seen are kept open in P, P[v]
+ * holding the high and low children found so far for the node on variable v.
+ * Once the next key leaves that path at variable d, the nodes below d can get
+ * no more children: they are made bottom up, each one becoming a child of its
+ * parent, and the node on d then gets the next key as its high child. */
+
+bdd_ref bdd::from_keys(const uint64_t* k, size_t n, size_t words,
+	bdd_shft nvars)
+{
+	auto bit = [](const uint64_t* key, bdd_shft v) {
+		return (key[(v - 1) / 64] >> (63 - (v - 1) % 64)) & 1;
+	};
+	// P[0][0] receives the root
+	vector<array<bdd_ref, 2>> P(nvars + 1, { F, F });
+	auto close = [&P, &bit, nvars](const uint64_t* key, bdd_shft d) {
+		for (bdd_shft v = nvars; v != d; --v)
+			P[v - 1][v == 1 ? 0 : bit(key, v - 1)] =
+				add(v, P[v][1], P[v][0]),
+			P[v] = { F, F };
+	};
+	for (size_t i = 0; i != n; ++i) {
+		const uint64_t* key = k + i * words;
+		if (i) {
+			const uint64_t* prev = key - words;
+			size_t w = 0;
+			while (prev[w] == key[w]) ++w;
+			close(prev, w * 64 + __builtin_clzll(prev[w] ^ key[w]) + 1);
+		}
+		P[nvars][bit(key, nvars)] = T;
+	}
+	return close(k + (n - 1) * words, 0), P[0][0];
+}
+
+spbdd_handle from_keys(vector<uint64_t> keys, size_t words, bdd_shft nvars) {
+	if (keys.empty()) return hfalse;
+	if (!nvars) return htrue;
+	DBG(assert(words == (nvars + 63) / 64 && keys.size() % words == 0);)
+	const size_t n = keys.size() / words;
+	if (words == 1) {
+		// Least significant digit radix sort on the bytes that can be nonzero
+		vector<uint64_t> t(n);
+		for (size_t sh = 64 - (nvars + 7) / 8 * 8; sh != 64; sh += 8) {
+			size_t cnt[257] = { 0 };
+			for (uint64_t x : keys) ++cnt[((x >> sh) & 255) + 1];
+			for (size_t d = 0; d != 256; ++d) cnt[d + 1] += cnt[d];
+			for (uint64_t x : keys) t[cnt[(x >> sh) & 255]++] = x;
+			keys.swap(t);
+		}
+		keys.erase(unique(keys.begin(), keys.end()), keys.end());
+	} else {
+		auto less = [&keys, words](size_t x, size_t y) {
+			return lexicographical_compare(
+				&keys[x * words], &keys[(x + 1) * words],
+				&keys[y * words], &keys[(y + 1) * words]);
+		};
+		vector<size_t> ix(n);
+		for (size_t i = 0; i != n; ++i) ix[i] = i;
+		sort(ix.begin(), ix.end(), less);
+		vector<uint64_t> t;
+		t.reserve(keys.size());
+		for (size_t i = 0; i != n; ++i)
+			if (!i || less(ix[i - 1], ix[i]))
+				t.insert(t.end(), &keys[ix[i] * words],
+					&keys[(ix[i] + 1) * words]);
+		keys.swap(t);
+	}
+	return bdd_handle::get(bdd::from_keys(keys.data(), keys.size() / words,
+		words, nvars));
+}
+
+bool bdd_save(const string& fn, const bdd_handles& roots) {
+	bdds r;
+	r.reserve(roots.size());
+	for (cr_spbdd_handle x : roots) r.push_back(x->b);
+	return bdd::save(fn, r);
+}
+
+bool bdd_load(const string& fn, bdd_handles& roots) {
+	bdds r;
+	if (!bdd::load(fn, r)) return false;
+	roots.clear(), roots.reserve(r.size());
+	for (bdd_ref x : r) roots.push_back(bdd_handle::get(x));
+	return true;
+}
+
 void bdd::sat(bdd_shft v, bdd_shft nvars, bdd_ref  t, bools& p, vbools& r) {
 	if (t == F) return;
 	if (!leaf(t) && v < var(t))
@@ -929,63 +1502,182 @@ void allsat_cb::sat(bdd_ref x) {
 	else f(p, x);
 }
 
+/* Compute exists b (x), leaving the variables after last + 1 alone. */
+
+struct bdd::op_ex {
+	const bools& b;
+	unordered_map<bdd_ref, bdd_ref>& memo;
+	bdd_shft last;
+	bool leaf(frame& f, bdd_ref& r) const {
+		for (bdd_ref x = f.x; ; x = bdd_or(hi(x), lo(x))) {
+			if (bdd::leaf(x) || var(x) > last+1) return r = x, true;
+			auto it = memo.find(x);
+			if (it != memo.end()) return r = it->second, true;
+			DBG(assert(var(x)-1 < b.size());)
+			if (!b[var(x) - 1]) return f.x = x, false;
+		}
+	}
+	void split(frame& f, frame& h, frame& l) const {
+		f.v = var(f.x), h = { hi(f.x), 0, 0 }, l = { lo(f.x), 0, 0 };
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) const {
+		return memo.emplace(f.x, add(f.v, h, l)).first->second;
+	}
+};
+
 bdd_ref bdd::bdd_ex(bdd_ref x, const bools& b, unordered_map<bdd_ref, bdd_ref>& memo,
 	bdd_shft last) {
-	if (leaf(x) || var(x) > last+1) return x;
-	auto it = memo.find(x);
-	if (it != memo.end()) return it->second;
-	DBG(assert(var(x)-1 < b.size());)
-	if (b[var(x) - 1]) return bdd_ex(bdd_or(hi(x), lo(x)), b, memo, last);
-	return memo.emplace(x, bdd::add(var(x), bdd_ex(hi(x), b, memo, last),
-				bdd_ex(lo(x), b, memo, last))).first->second;
+	op_ex op{ b, memo, last };
+	return apply(op, x);
 }
 
 bdd_ref bdd::bdd_ex(bdd_ref x, const bools& b) {
-	bdd_shft last = 0;
-	for (bdd_shft n = 0; n != b.size(); ++n) if (b[n]) last = n;
-	return bdd_ex(x, b, memos_ex[b], last);
+	ex_perm_op& o = O[bdd_op_id(b, {})];
+	return bdd_ex(x, b, o.m1, o.last);
 }
 
 spbdd_handle operator/(cr_spbdd_handle x, const bools& b) {
 	return bdd_handle::get(bdd::bdd_ex(x->b, b));
 }
 
+/* Rename the variables of x according to m. */
+
+struct bdd::op_permute {
+	const bdd_shfts& m;
+	unordered_map<bdd_ref, bdd_ref>& memo;
+	bool leaf(frame& f, bdd_ref& r) const {
+		const bdd_ref x = f.x;
+		if (bdd::leaf(x) || m.size() <= var(x)-1) return r = x, true;
+		auto it = memo.find(x);
+		return it != memo.end() && (r = it->second, true);
+	}
+	void split(frame& f, frame& h, frame& l) const {
+		f.v = var(f.x), h = { hi(f.x), 0, 0 }, l = { lo(f.x), 0, 0 };
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) const {
+		return memo.emplace(f.x, bdd_ite_var(m[f.v-1], h, l))
+			.first->second;
+	}
+};
+
 bdd_ref bdd::bdd_permute(bdd_ref x, const bdd_shfts& m,
 		unordered_map<bdd_ref, bdd_ref>& memo) {
-	if (leaf(x) || m.size() <= var(x)-1) return x;
-	auto it = memo.find(x);
-	if (it != memo.end()) return it->second;
-	return memo.emplace(x, bdd_ite_var(m[var(x)-1],
-		bdd_permute(hi(x), m, memo),
-		bdd_permute(lo(x), m, memo))).first->second;
+	op_permute op{ m, memo };
+	return apply(op, x);
 }
 
 spbdd_handle operator^(cr_spbdd_handle x, const bdd_shfts& m) {
 //	DBG(assert(bdd_nvars(x) < m.size());)
-	return bdd_handle::get(bdd::bdd_permute(x->b, m, memos_perm[m]));
+	return bdd_handle::get(bdd::bdd_permute(x->b, m, perm_memo(m)));
 }
 
+/* Compute exists b (x) renamed according to m, leaving the variables after
+ * last + 1 alone. The frames keep the BDD asked for as x and the one left of
+ * it once its leading quantified variables are gone as y. */
+
+struct bdd::op_permute_ex {
+	const bools& b;
+	const bdd_shfts& m;
+	bdd_shft last;
+	unordered_map<bdd_ref, bdd_ref>& memo;
+	bool leaf(frame& f, bdd_ref& r) const {
+		const bdd_ref x = f.x;
+		if (bdd::leaf(x) || var(x) > last+1) return r = x, true;
+		auto it = memo.find(x);
+		if (it != memo.end()) return r = it->second, true;
+		bdd_ref y = x;
+		DBG(assert(b.size() >= var(x));)
+		for (; var(y)-1 < b.size() && b[var(y)-1]; y = r)
+			if (bdd::leaf((r = bdd_or(hi(y), lo(y)))))
+				return memo.emplace(x, r), true;
+			DBG(else assert(b.size() >= var(r));)
+		DBG(assert(!bdd::leaf(y) && m.size() >= var(y));)
+		return f.y = y, false;
+	}
+	void split(frame& f, frame& h, frame& l) const {
+		f.v = var(f.y), h = { hi(f.y), 0, 0 }, l = { lo(f.y), 0, 0 };
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) const {
+		return memo.emplace(f.x, bdd_ite_var(m[f.v-1], h, l))
+			.first->second;
+	}
+};
+
 bdd_ref bdd::bdd_permute_ex(bdd_ref x, const bools& b, const bdd_shfts& m, bdd_shft last,
 	unordered_map<bdd_ref, bdd_ref>& memo) {
-	if (leaf(x) || var(x) > last+1) return x;
-	auto it = memo.find(x);
-	if (it != memo.end()) return it->second;
-	bdd_ref t = x, y = x;
-	DBG(assert(b.size() >= var(x));)
-	for (bdd_ref r; var(y)-1 < b.size() && b[var(y)-1]; y = r)
-		if (leaf((r = bdd_or(hi(y), lo(y)))))
-			return memo.emplace(t, r), r;
-		DBG(else assert(b.size() >= var(r));)
-	DBG(assert(!leaf(y) && m.size() >= var(y));)
-	return	memo.emplace(t, bdd_ite_var(m[var(y)-1],
-		bdd_permute_ex(hi(y), b, m, last, memo),
-		bdd_permute_ex(lo(y), b, m, last, memo))).first->second;
+	op_permute_ex op{ b, m, last, memo };
+	return apply(op, x);
 }
 
 bdd_ref bdd::bdd_permute_ex(bdd_ref x, const bools& b, const bdd_shfts& m) {
-	bdd_shft last = 0;
-	for (bdd_shft n = 0; n != b.size(); ++n) if (b[n] || (m[n]!=n)) last = n;
-	return bdd_permute_ex(x, b, m, last, memos_perm_ex[{m,b}]);
+	return bdd_permute_ex(x, bdd_op_id(b, m));
+}
+
+bdd_ref bdd::bdd_permute_ex(bdd_ref x, size_t op) {
+	ex_perm_op& o = O[op];
+	if (shiftable(x, op)) return bdd_ex_shift(x, op);
+	return bdd_permute_ex(x, o.ex, o.p, o.last, o.m1);
+}
+
+/* Check whether x depends on no variable past last + 1. */
+
+struct bdd::op_within {
+	bdd_shft last;
+	unordered_map<bdd_ref, bdd_ref>& memo;
+	bool leaf(frame& f, bdd_ref& r) const {
+		// Inverters do not change the variables a BDD depends on
+		const bdd_ref x = f.x = BDD_ABS(f.x);
+		if (bdd::leaf(x)) return r = T, true;
+		if (var(x) > last+1) return r = F, true;
+		auto it = memo.find(x);
+		return it != memo.end() && (r = it->second, true);
+	}
+	void split(frame& f, frame& h, frame& l) const {
+		f.v = var(f.x), h = { hi(f.x), 0, 0 }, l = { lo(f.x), 0, 0 };
+	}
+	bdd_ref join(const frame& f, bdd_ref h, bdd_ref l) const {
+		return memo.emplace(f.x, h == T && l == T ? T : F).first->second;
+	}
+};
+
+/* Check whether the uniform operation op may be applied to x by shifting. */
+
+bool bdd::shiftable(bdd_ref x, size_t op) {
+	ex_perm_op& o = O[op];
+	if (!o.uniform) return false;
+	if (!o.off) return true;
+	op_within w{ o.last, o.mw };
+	return apply(w, x) == T;
+}
+
+/* Shift the result r of the uniform operation op by its offset. Unless the
+ * offset is 0, the operands of op, and so r, depend on no variable past last + 1
+ * which thus bounds the variables of the shifted result. */
+
+bdd_ref bdd::ex_perm_shift(bdd_ref r, size_t op) {
+	const ex_perm_op& o = O[op];
+	if (o.off > 0) check_var(o.last + 1 + o.off);
+	return PLUS_SHIFT(r, o.off);
+}
+
+/* Apply the uniform operation op to x without traversing it for the renaming:
+ * quantify its variables, if any, and shift the result by the offset. */
+
+bdd_ref bdd::bdd_ex_shift(bdd_ref x, size_t op) {
+	ex_perm_op& o = O[op];
+	DBG(assert(shiftable(x, op));)
+	bdd_ref r = x;
+	if (o.quant) {
+		ex_perm_op& e = O[ex_op(op)];
+		r = bdd_ex(x, e.ex, e.m1, e.last);
+	}
+	r = ex_perm_shift(r, op);
+	DBG(assert(r == bdd_permute_ex(x, o.ex, o.p, o.last, o.m1));)
+	return r;
+}
+
+unordered_map<bdd_ref, bdd_ref>& perm_memo(const bdd_shfts& m) {
+	return O[bdd_op_id({}, m)].mp;
 }
 
 spbdd_handle bdd_permute_ex(cr_spbdd_handle x, const bools& b, const bdd_shfts& m) {
@@ -994,6 +1686,19 @@ spbdd_handle bdd_permute_ex(cr_spbdd_handle x, const bools& b, const bdd_shfts&
 	return bdd_handle::get(bdd::bdd_permute_ex(x->b, b, m));
 }
 
+spbdd_handle bdd_permute_ex(cr_spbdd_handle x, size_t op) {
+	return bdd_handle::get(bdd::bdd_permute_ex(x->b, op));
+}
+
+spbdd_handle bdd_and_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y, size_t op) {
+	return bdd_handle::get(bdd::bdd_and_ex_perm(x->b, y->b, op));
+}
+
+spbdd_handle bdd_and_not_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y,
+	size_t op) {
+	return bdd_handle::get(bdd::bdd_and_ex_perm(x->b, FLIP_INV_OUT(y->b), op));
+}
+
 spbdd_handle bdd_and_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y,
 	const bools& b, const bdd_shfts& m) {
 //	DBG(assert(bdd_nvars(x) < b.size());)
@@ -1078,10 +1783,6 @@ template basic_ostream<char>& out(basic_ostream<char>&, cr_spbdd_handle);
 template basic_ostream<wchar_t>& out(basic_ostream<wchar_t>&, cr_spbdd_handle);
 
 
-size_t hash<ite_memo>::operator()(const ite_memo& m) const {
-	return m.hash;
-}
-
 size_t hash<array<int_t, 2>>::operator()(const array<int_t, 2>& x) const {
 	return hash_pair(x[0], x[1]);
 }
@@ -1091,7 +1792,6 @@ size_t hash<array<bdd_ref, 2>>::operator()(const array<bdd_ref, 2>& x) const {
 	return hash_upair(hsh(x[0]), hsh(x[1]));
 }
 
-size_t hash<bdd_key>::operator()(const bdd_key& k) const {return k.hash;}
 
 bdd::bdd(bdd_ref h, bdd_ref l) : h(h), l(l) {
 //	DBG(assert(V.size() < 2 || (v && h && l));)
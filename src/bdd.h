@@ -10,6 +10,8 @@
 // from the Author (Ohad Asor).
 // Contact ohad@idni.org for requesting a permission. This license may be
 // modified over time by the Author.
+#ifndef __BDD_H__
+#define __BDD_H__
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -20,7 +22,10 @@
 #include <memory>
 #include <functional>
 #include <climits>
+#include <type_traits>
+#include <stdexcept>
 #include "defs.h"
+#include "big_uint.h"
 #ifndef NOMMAP
 #include "memory_map.h"
 #endif
@@ -50,9 +55,29 @@ extern bool onexit;
  * INV_OUT: 63-64.
  * The terminal node invariants are: BDD_ID <= 1 --> SHIFT = 0 and
  * BDD_ID <= 1 --> INV_INP = 0 and BDD_ID = 0 --> INV_OUT = 0. All these ensure
- * that each attributed edge has a unique representation. */
+ * that each attributed edge has a unique representation.
+ * With BDD_COMPACT_REFS the reference is 32 bits wide, the BDD ID taking its
+ * low BDD_ID_BITS bits (24 unless defined otherwise), the shift the bits up to
+ * 30 and the inverters the top two, so that a BDD takes 8 bytes instead of
+ * 16. bdd::add, and the operations shifting existing references, fail once
+ * either no longer fits. */
+#ifdef BDD_COMPACT_REFS
+typedef uint32_t bdd_ref;
+typedef uint32_t bdd_id;
+#ifndef BDD_ID_BITS
+#define BDD_ID_BITS 24
+#endif
+#define BDD_REF_BITS 32
+#else
 typedef uint64_t bdd_ref;
 typedef uint64_t bdd_id;
+#define BDD_ID_BITS 38
+#define BDD_REF_BITS 64
+#endif
+static_assert(BDD_ID_BITS > 1 && BDD_ID_BITS < BDD_REF_BITS - 2,
+	"BDD_ID_BITS leaves no room for the shift");
+// End of the shift bits, followed by the input and output inverters
+#define BDD_SHIFT_END (BDD_REF_BITS - 2)
 typedef uint32_t bdd_shft;
 typedef std::vector<bdd_shft> bdd_shfts;
 // Make a selector for the given bits of a 64-bit unsigned integer
@@ -66,34 +91,39 @@ typedef std::vector<bdd_shft> bdd_shfts;
 // Replace the given bits of x with the low bits of y
 #define REPL64(low, high, x, y) (((x) & ~MASK64(low, high)) | PLACE64(low, high, y))
 // Construct a BDD reference with the given ID, shift, and inverters
-#define BDD_REF(id, shift, inv_inp, inv_out) (PLACE64(0,38,id) | \
-	PLACE64(38,62,(id) <= 1 ? 0 : (shift)) | PLACE64(62,63,(id) <= 1 ? 0 : (inv_inp)) | \
-	PLACE64(63,64,(id) ? (inv_out) : 0))
+#define BDD_REF(id, shift, inv_inp, inv_out) ((bdd_ref) (PLACE64(0,BDD_ID_BITS,id) | \
+	PLACE64(BDD_ID_BITS,BDD_SHIFT_END,(id) <= 1 ? 0 : (shift)) | \
+	PLACE64(BDD_SHIFT_END,BDD_SHIFT_END+1,(id) <= 1 ? 0 : (inv_inp)) | \
+	PLACE64(BDD_SHIFT_END+1,BDD_REF_BITS,(id) ? (inv_out) : 0)))
 // Get the BDD identified by this BDD reference
-#define GET_BDD_ID(x) ((bdd_id) GET64(0,38,x))
+#define GET_BDD_ID(x) ((bdd_id) GET64(0,BDD_ID_BITS,x))
 // Get the shift applied by this BDD reference
-#define GET_SHIFT(x) ((bdd_shft) GET32(6,30,((uint32_t)((x) >> 32))))
+#define GET_SHIFT(x) ((bdd_shft) GET64(BDD_ID_BITS,BDD_SHIFT_END,x))
 // Is the input of this BDD reference inverted?
-#define GET_INV_INP(x) GET32(30,31,((uint32_t)((x) >> 32)))
+#define GET_INV_INP(x) GET64(BDD_SHIFT_END,BDD_SHIFT_END+1,x)
 // Is the output of this BDD reference inverted?
-#define GET_INV_OUT(x) GET32(31,32,((uint32_t)((x) >> 32)))
+#define GET_INV_OUT(x) GET64(BDD_SHIFT_END+1,BDD_REF_BITS,x)
 // Set the BDD identified by this reference
-#define SET_BDD_ID(y, x) (y = REPL64(0,38,y,x))
+#define SET_BDD_ID(y, x) (y = (bdd_ref) REPL64(0,BDD_ID_BITS,y,x))
 // Remove the output inverter from the BDD reference
-#define BDD_ABS(x) (((uint64_t)(x)) & (uint64_t(-1) >> 1))
+#define BDD_ABS(x) (((bdd_ref)(x)) & (bdd_ref(-1) >> 1))
 // Increase the shift of the BDD reference, terminal nodes cannot be shifted
-#define PLUS_SHIFT(y, x) (GET_BDD_ID(y) > 1 ? REPL64(38,62,y,GET_SHIFT(y)+((int32_t)(x))) : (y))
+#define PLUS_SHIFT(y, x) (GET_BDD_ID(y) > 1 ? (bdd_ref) REPL64(BDD_ID_BITS, \
+	BDD_SHIFT_END,y,GET_SHIFT(y)+((int32_t)(x))) : (y))
 #define INCR_SHIFT(y, x) (y = PLUS_SHIFT(y, x))
 // Decrease the shift of the BDD reference, terminal nodes cannot be shifted
-#define MINUS_SHIFT(y, x) (GET_BDD_ID(y) > 1 ? REPL64(38,62,y,GET_SHIFT(y)-((int32_t)(x))) : (y))
+#define MINUS_SHIFT(y, x) (GET_BDD_ID(y) > 1 ? (bdd_ref) REPL64(BDD_ID_BITS, \
+	BDD_SHIFT_END,y,GET_SHIFT(y)-((int32_t)(x))) : (y))
 #define DECR_SHIFT(y, x) (y = MINUS_SHIFT(y, x))
 // Invert supplied BDD reference, the 0 node cannot be inverted
-#define FLIP_INV_OUT(x) (GET_BDD_ID(x) ? ((x) ^ (uint64_t(1) << 63)) : (x))
+#define FLIP_INV_OUT(x) (GET_BDD_ID(x) ? (bdd_ref) ((x) ^ \
+	(bdd_ref(1) << (BDD_REF_BITS - 1))) : (x))
 // Compare BDD references in such a way that output inverted ones are <0
-#define BDD_LT(x, y) (((int64_t)(x)) < ((int64_t)(y)))
+#define BDD_LT(x, y) (((std::make_signed_t<bdd_ref>)(x)) < \
+	((std::make_signed_t<bdd_ref>)(y)))
 
 class bdd;
-typedef std::shared_ptr<class bdd_handle> spbdd_handle;
+typedef class bdd_handle spbdd_handle;
 typedef const spbdd_handle& cr_spbdd_handle;
 typedef std::vector<bdd_ref> bdds;
 typedef std::vector<spbdd_handle> bdd_handles;
@@ -105,29 +135,200 @@ typedef std::vector<class bdd> bdd_mmap;
 typedef std::vector<class bdd, memory_map_allocator<bdd> >bdd_mmap;
 #endif
 
-struct ite_memo {
-	bdd_ref x, y, z;
-	size_t hash;
-	ite_memo(bdd_ref x, bdd_ref y, bdd_ref z) :
-		x(x), y(y), z(z) { rehash(); }
-	void rehash() {
-		std::hash<bdd_ref> hsh;
-		hash = hash_utri(hsh(x), hsh(y), hsh(z));
+/* A lossy, direct-mapped computed table in the style of CUDD. Entries live in
+ * a power of two sized array indexed by a hash of the operands and a new result
+ * overwrites whatever occupies its slot. Memory is bounded by the table size
+ * and, unlike a map that stops accepting results once it is full, the table
+ * keeps the most recent results cached for the whole run. The table grows along
+ * with the node store up to 2^max_log2 entries. A zero x marks an empty slot,
+ * BDD ID 0 is never referenced.
+ * Every entry records the generation it was written in, and B maps each BDD ID
+ * to the generation its current BDD was created in. The garbage collector
+ * starts a new generation instead of sweeping the table: an entry from an
+ * older generation is only trusted once all of its BDDs are checked to have
+ * been created no later than the entry itself. */
+class computed_table {
+	struct entry { bdd_ref x, y, z, r; uint32_t g; };
+	std::vector<entry> E;
+	const std::vector<uint32_t>* B = 0;
+	size_t mask = 0, used = 0;
+	uint32_t gen = 0;
+	static const size_t max_log2 = 22;
+	bool valid(const entry& e) const {
+		auto born = [this, &e](bdd_ref x) {
+			return (*B)[GET_BDD_ID(x)] <= e.g; };
+		return born(e.x) && born(e.y) && born(e.z) && born(e.r);
+	}
+	size_t slot(bdd_ref x, bdd_ref y, bdd_ref z) const {
+		uint64_t h = x * 0x9e3779b97f4a7c15ull;
+		h = (h ^ (h >> 31) ^ y) * 0xbf58476d1ce4e5b9ull;
+		h = (h ^ (h >> 27) ^ z) * 0x94d049bb133111ebull;
+		return (h ^ (h >> 31)) & mask;
+	}
+	void resize(size_t n) {
+		std::vector<entry> e(n, entry{ 0, 0, 0, 0, 0 });
+		std::swap(E, e), mask = n - 1, used = 0;
+		for (const entry& x : e) if (x.x) {
+			entry& y = E[slot(x.x, x.y, x.z)];
+			if (!y.x) ++used;
+			y = x;
+		}
+	}
+public:
+	void init(size_t log2, const std::vector<uint32_t>& b) {
+		B = &b, gen = 0, E.clear(), resize(size_t(1) << log2);
+	}
+	bool find(bdd_ref x, bdd_ref y, bdd_ref z, bdd_ref& r) {
+		entry& e = E[slot(x, y, z)];
+		if (e.x != x || e.y != y || e.z != z) return false;
+		if (e.g != gen) {
+			if (!valid(e)) return e.x = 0, --used, false;
+			e.g = gen;
+		}
+		return r = e.r, true;
+	}
+	// As find but leaving the entry alone, so that threads can share it
+	bool peek(bdd_ref x, bdd_ref y, bdd_ref z, bdd_ref& r) const {
+		const entry& e = E[slot(x, y, z)];
+		if (e.x != x || e.y != y || e.z != z) return false;
+		if (e.g != gen && !valid(e)) return false;
+		return r = e.r, true;
 	}
-	bool operator==(const ite_memo& k) const{return x==k.x&&y==k.y&&z==k.z;}
+	void insert(bdd_ref x, bdd_ref y, bdd_ref z, bdd_ref r) {
+		entry& e = E[slot(x, y, z)];
+		if (!e.x) ++used;
+		e = { x, y, z, r, gen };
+	}
+	// Double the table unless it already reached its maximum size
+	void grow() { if (E.size() < (size_t(1) << max_log2)) resize(E.size()<<1); }
+	uint32_t generation() const { return gen; }
+	void next_generation() { ++gen; }
+	size_t size() const { return used; }
+	size_t capacity() const { return E.size(); }
 };
 
-struct bdd_key {
-	uint_t hash;
-	bdd_ref h, l;
-	bdd_key(){}
-	bdd_key(uint_t hash, bdd_ref h, bdd_ref l) :
-		hash(hash), h(h), l(l) {}
-	bool operator==(const bdd_key& k) const { return h==k.h && l==k.l; }
+/* The unique table mapping a BDD definition (h, l) to its ID. Open addressing
+ * with linear probing over entries stored inline, so a probe touches a single
+ * cache line and no node is allocated per BDD. When the load factor is exceeded
+ * the table doubles incrementally: inserts go to the new array while every
+ * insert migrates a few slots of the old one, which is kept read-only and is
+ * also searched until migration completes. Entries are never erased, gc
+ * rebuilds the table from scratch.
+ * Several threads may insert at once by find_or_insert_mt, which claims an
+ * empty slot by swapping its ID for busy and publishes the entry by storing
+ * its ID. The table must then be settled and reserved for every insert. */
+class unique_table {
+public:
+	struct entry { bdd_ref h, l; bdd_id id; };
+	static const bdd_id empty = bdd_id(-1);
+private:
+	static const bdd_id busy = bdd_id(-2);
+	static const size_t min_log2 = 10, migrate_step = 4;
+	std::vector<entry> E, O; // current and, while resizing, old entries
+	size_t log2 = 0, used = 0, moved = 0;
+	static size_t slot(bdd_ref h, bdd_ref l, size_t log2) {
+		return (hash_upair(h, l) * 0x9e3779b97f4a7c15ull) >> (64 - log2);
+	}
+	static bool find(const std::vector<entry>& e, size_t log2, bdd_ref h,
+		bdd_ref l, size_t& n)
+	{
+		const size_t mask = e.size() - 1;
+		for (n = slot(h, l, log2); e[n].id != empty; n = (n + 1) & mask)
+			if (e[n].h == h && e[n].l == l) return true;
+		return false;
+	}
+	void migrate() {
+		size_t n;
+		for (size_t k = 0; k != migrate_step && moved != O.size(); ++k) {
+			const entry& x = O[moved++];
+			if (x.id != empty && !find(E, log2, x.h, x.l, n)) E[n] = x;
+		}
+		if (moved == O.size()) O.clear(), O.shrink_to_fit();
+	}
+	void resize(size_t l2) {
+		if (!O.empty()) while (!O.empty()) migrate();
+		O.swap(E), E.assign(size_t(1) << (log2 = l2), entry{0, 0, empty});
+		moved = 0;
+	}
+public:
+	unique_table() { clear(); }
+	/* Get the ID of the BDD (h, l) into id if it exists, otherwise insert
+	 * it under the given id. Returns whether the BDD already existed. */
+	bool find_or_insert(bdd_ref h, bdd_ref l, bdd_id& id) {
+		size_t n, k;
+		if (find(E, log2, h, l, n)) return id = E[n].id, true;
+		if (!O.empty()) {
+			if (find(O, log2 - 1, h, l, k)) return id = O[k].id, true;
+			migrate();
+			// migration may have placed entries on the probe path
+			find(E, log2, h, l, n);
+		}
+		E[n] = { h, l, id };
+		if (++used * 10 > E.size() * 7) resize(log2 + 1);
+		return false;
+	}
+	/* find_or_insert for threads inserting at once. The ID of a new entry
+	 * is got from alloc, which may fail by returning empty, leaving the
+	 * table as it was and id empty. */
+	template <typename Alloc>
+	bool find_or_insert_mt(bdd_ref h, bdd_ref l, bdd_id& id, Alloc alloc) {
+		const size_t mask = E.size() - 1;
+		for (size_t n = slot(h, l, log2);; n = (n + 1) & mask) {
+			entry& e = E[n];
+			bdd_id x = __atomic_load_n(&e.id, __ATOMIC_ACQUIRE);
+			if (x == empty && __atomic_compare_exchange_n(&e.id, &x,
+				busy, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+			{
+				if ((id = alloc()) == empty) return
+					__atomic_store_n(&e.id, empty,
+						__ATOMIC_RELEASE), false;
+				e.h = h, e.l = l;
+				__atomic_store_n(&e.id, id, __ATOMIC_RELEASE);
+				return __atomic_fetch_add(&used, 1,
+					__ATOMIC_RELAXED), false;
+			}
+			// wait for the entry claimed by another thread
+			while (x == busy)
+				x = __atomic_load_n(&e.id, __ATOMIC_ACQUIRE);
+			if (x == empty) n = (n - 1) & mask;
+			else if (e.h == h && e.l == l) return id = x, true;
+		}
+	}
+	void reserve(size_t n) {
+		size_t l2 = min_log2;
+		while ((size_t(1) << l2) * 7 < n * 10) ++l2;
+		if (l2 <= log2) return;
+		if (used) resize(l2);
+		else E.assign(size_t(1) << (log2 = l2), entry{0, 0, empty});
+	}
+	void clear() {
+		E.assign(size_t(1) << (log2 = min_log2), entry{0, 0, empty});
+		O.clear(), O.shrink_to_fit(), used = moved = 0;
+	}
+	size_t size() const { return used; }
+	// The 2^slots_log2() slots of the table once any migration is done,
+	// which is how bdd::save stores it
+	const std::vector<entry>& slots() { return settle(), E; }
+	// Complete any migration
+	void settle() { while (!O.empty()) migrate(); }
+	size_t slots_log2() const { return log2; }
+	/* Take the 2^l2 slots s holding n entries as they are, without hashing
+	 * them again. Fails, leaving the table alone, unless every entry is
+	 * the first one with its key found probing from its slot and the load
+	 * factor leaves room for inserts. */
+	bool adopt(const entry* s, size_t l2, size_t n) {
+		if (l2 < min_log2 || l2 >= 48) return false;
+		const size_t mask = (size_t(1) << l2) - 1;
+		if (n * 10 > (mask + 1) * 7) return false;
+		for (size_t k = 0; k <= mask; ++k) if (s[k].id != empty)
+			for (size_t j = slot(s[k].h, s[k].l, l2); j != k;
+				j = (j + 1) & mask)
+				if (s[j].id == empty || (s[j].h == s[k].h &&
+					s[j].l == s[k].l)) return false;
+		E.assign(s, s + mask + 1), O.clear(), O.shrink_to_fit();
+		return log2 = l2, used = n, moved = 0, true;
+	}
 };
-
-template<> struct std::hash<bdd_key> {size_t operator()(const bdd_key&)const;};
-template<> struct std::hash<ite_memo>{size_t operator()(const ite_memo&)const;};
 template<> struct std::hash<std::array<int_t, 2>>{
 	size_t operator()(const std::array<int_t, 2>&) const;
 };
@@ -142,6 +343,17 @@ spbdd_handle from_bit(bdd_shft b, bool v);
 spbdd_handle from_high(bdd_shft s, bdd_ref x);
 spbdd_handle from_low(bdd_shft s, bdd_ref y);
 spbdd_handle from_high_and_low(bdd_shft s, bdd_ref x, bdd_ref y);
+// Builds the BDD over the variables 1..nvars that is satisfied by exactly the
+// given keys. Each key is a run of words 64 bit words holding variable v in
+// bit 63 - (v-1)%64 of its word (v-1)/64, so keys compare as the assignments
+// they stand for. Duplicate keys are allowed.
+spbdd_handle from_keys(std::vector<uint64_t> keys, size_t words,
+	bdd_shft nvars);
+// Saves the node store along with the given roots into a file
+bool bdd_save(const std::string& fn, const bdd_handles& roots);
+// Loads a node store saved by bdd_save into the empty store left by
+// bdd::init, and gets the handles of its roots
+bool bdd_load(const std::string& fn, bdd_handles& roots);
 
 bool leaf(cr_spbdd_handle h);
 bool trueleaf(cr_spbdd_handle h);
@@ -163,6 +375,7 @@ spbdd_handle bdd_ite_var(bdd_shft x, cr_spbdd_handle y, cr_spbdd_handle z);
 spbdd_handle bdd_and_many(bdd_handles v);
 spbdd_handle bdd_and_many_ex(bdd_handles v, const bools& ex);
 spbdd_handle bdd_or_many(bdd_handles v);
+bool bdd_update(cr_spbdd_handle t, bdd_handles a, bdd_handles d, spbdd_handle& r);
 spbdd_handle bdd_and_ex(cr_spbdd_handle x, cr_spbdd_handle y, const bools& b);
 spbdd_handle bdd_and_not_ex(cr_spbdd_handle x, cr_spbdd_handle y, const bools&);
 spbdd_handle bdd_and_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y,
@@ -171,6 +384,15 @@ spbdd_handle bdd_and_not_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y,
 	const bools& b, const bdd_shfts& m);
 spbdd_handle bdd_and_many_ex_perm(bdd_handles v, const bools& b, const bdd_shfts&);
 spbdd_handle bdd_permute_ex(cr_spbdd_handle x, const bools& b, const bdd_shfts& m);
+// Interns the quantification of the variables b followed by the renaming m and
+// returns its ID. The overloads below taking an ID skip the lookup of b and m.
+size_t bdd_op_id(const bools& b, const bdd_shfts& m);
+spbdd_handle bdd_and_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y, size_t op);
+spbdd_handle bdd_and_not_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y,
+	size_t op);
+spbdd_handle bdd_and_many_ex_perm(bdd_handles v, size_t op);
+spbdd_handle bdd_permute_ex(cr_spbdd_handle x, size_t op);
+std::unordered_map<bdd_ref, bdd_ref>& perm_memo(const bdd_shfts& m);
 spbdd_handle from_eq(bdd_shft x, bdd_shft y);
 std::array<spbdd_handle, 2> solve(spbdd_handle x, bdd_shft v);
 bdd_ref bdd_or_reduce(bdds b);
@@ -235,7 +457,13 @@ spbdd_handle bdd_mult_dfs(cr_spbdd_handle x, cr_spbdd_handle y, size_t bits,
 spbdd_handle bdd_quantify(cr_spbdd_handle x, const std::vector<quant_t> &quants,
 		const size_t bits, const size_t n_args);
 
+// Counts the assignments to the variables 1..bits satisfying x. The count is
+// exact, takes time linear in the size of x, and saturates at SIZE_MAX.
 size_t satcount(cr_spbdd_handle x, const size_t bits);
+big_uint satcount_exact(cr_spbdd_handle x, const size_t bits);
+// Approximates the base 2 logarithm of the count without overflowing. It is
+// -infinity if x is false.
+double satcount_log2(cr_spbdd_handle x, const size_t bits);
 void allsat_bin(cr_spbdd_handle x);
 //size_t satcount_ex(cr_spbdd_handle x, const size_t bits, const bools &ex);
 
@@ -246,6 +474,7 @@ void allsat_bin(cr_spbdd_handle x);
 class bdd {
 	friend class bdd_handle;
 	friend class allsat_cb;
+	template <typename Sink> friend class allsat_batch;
 	friend struct sbdd_and_many_ex;
 	friend struct sbdd_and_ex_perm;
 	friend struct sbdd_and_many_ex_perm;
@@ -264,6 +493,8 @@ class bdd {
 	friend spbdd_handle bdd_and_many(bdd_handles v);
 	friend spbdd_handle bdd_and_many_ex(bdd_handles v, const bools& ex);
 	friend spbdd_handle bdd_or_many(bdd_handles v);
+	friend bool bdd_update(cr_spbdd_handle t, bdd_handles a, bdd_handles d,
+		spbdd_handle& r);
 	friend spbdd_handle bdd_permute_ex(cr_spbdd_handle x, const bools& b,
 		const bdd_shfts& m);
 	friend spbdd_handle bdd_and_ex_perm(cr_spbdd_handle x, cr_spbdd_handle,
@@ -274,6 +505,12 @@ class bdd {
 		const bdd_shfts&);
 	friend spbdd_handle bdd_and_ex(cr_spbdd_handle x, cr_spbdd_handle y,
 		const bools& b);
+	friend spbdd_handle bdd_and_ex_perm(cr_spbdd_handle x, cr_spbdd_handle y,
+		size_t op);
+	friend spbdd_handle bdd_and_not_ex_perm(cr_spbdd_handle x,
+		cr_spbdd_handle y, size_t op);
+	friend spbdd_handle bdd_and_many_ex_perm(bdd_handles v, size_t op);
+	friend spbdd_handle bdd_permute_ex(cr_spbdd_handle x, size_t op);
 	friend spbdd_handle bdd_and_not_ex(cr_spbdd_handle x, cr_spbdd_handle y,
 		const bools&);
 	friend std::array<spbdd_handle, 2> solve(spbdd_handle x, bdd_shft v);
@@ -283,6 +520,10 @@ class bdd {
 	friend spbdd_handle from_high(bdd_shft s, bdd_ref x);
 	friend spbdd_handle from_low(bdd_shft s, bdd_ref y);
 	friend spbdd_handle from_high_and_low(bdd_shft s, bdd_ref x, bdd_ref y);
+	friend spbdd_handle from_keys(std::vector<uint64_t> keys, size_t words,
+		bdd_shft nvars);
+	friend bool bdd_save(const std::string& fn, const bdd_handles& roots);
+	friend bool bdd_load(const std::string& fn, bdd_handles& roots);
 	
 	friend bdd_shft bdd_nvars(spbdd_handle x);
 	friend bool leaf(cr_spbdd_handle h);
@@ -296,6 +537,8 @@ class bdd {
 	friend spbdd_handle bdd_quantify(cr_spbdd_handle x, const std::vector<quant_t> &quants,
 			const size_t bits, const size_t n_args);
 	friend size_t satcount(cr_spbdd_handle x, const size_t bits);
+	friend big_uint satcount_exact(cr_spbdd_handle x, const size_t bits);
+	friend double satcount_log2(cr_spbdd_handle x, const size_t bits);
 	friend void allsat_bin(cr_spbdd_handle x);
 	//friend size_t satcount_ex(cr_spbdd_handle x, const size_t bits, const bools& ex);
 	friend spbdd_handle bdd_bitwise_and(cr_spbdd_handle x, cr_spbdd_handle y);
@@ -327,8 +570,32 @@ class bdd {
 		return cbdd;
 	}
 
+	// The apply engine and the operations it runs, see bdd.cpp
+	struct frame;
+	struct op_and;
+	struct op_ite;
+	struct op_and_ex;
+	struct op_ex;
+	struct op_permute;
+	struct op_permute_ex;
+	struct op_within;
+	struct op_and_mt;
+	template <typename Op>
+	static bdd_ref apply(Op& op, bdd_ref x, bdd_ref y = 0, bdd_ref z = 0);
+	// The frames pending and the results computed by the apply engine, per
+	// thread
+	static thread_local std::vector<frame> AF;
+	static thread_local bdds AR;
+
 	static bdd_ref bdd_and(bdd_ref x, bdd_ref y);
+#ifdef WITH_THREADS
+	// The number of threads conjoining large BDDs, see bdd_and_par
+	static size_t threads;
+	static bdd_ref bdd_and_par(bdd_ref x, bdd_ref y);
+	static bdd_ref add_mt(bdd_shft v, bdd_ref h, bdd_ref l);
+#endif
 	static bdd_ref bdd_and_ex(bdd_ref x, bdd_ref y, const bools& ex);
+	static bdd_ref bdd_and_ex(bdd_ref x, bdd_ref y, size_t op);
 	static bdd_ref bdd_and_ex(bdd_ref x, bdd_ref y, const bools& ex,
 		std::unordered_map<std::array<bdd_ref, 2>, bdd_ref>& memo,
 		std::unordered_map<bdd_ref, bdd_ref>& memo2, bdd_shft last);
@@ -339,9 +606,12 @@ class bdd {
 		return FLIP_INV_OUT(and_ref);
 	}
 	static bdd_ref bdd_ite(bdd_ref x, bdd_ref y, bdd_ref z);
+	static bool bdd_and_cached(bdd_ref x, bdd_ref y, bdd_ref& r);
 	static bdd_ref bdd_ite_var(bdd_shft x, bdd_ref y, bdd_ref z);
 	static bdd_ref bdd_and_many(bdds v);
 	static bdd_ref bdd_and_many_ex(bdds v, const bools& ex);
+	static bdd_ref bdd_update(bdd_ref t, bdds a, bdds d,
+		std::unordered_map<bdds, bdd_ref>& memo);
 	static bdd_ref bdd_ex(bdd_ref x, const bools& b,
 		std::unordered_map<bdd_ref, bdd_ref>& memo, bdd_shft last);
 	static bdd_ref bdd_ex(bdd_ref x, const bools& b);
@@ -350,6 +620,14 @@ class bdd {
 	static bdd_ref bdd_permute_ex(bdd_ref x, const bools& b, const bdd_shfts& m,
 		bdd_shft last, std::unordered_map<bdd_ref, bdd_ref>& memo);
 	static bdd_ref bdd_permute_ex(bdd_ref x, const bools& b, const bdd_shfts& m);
+	static bdd_ref bdd_permute_ex(bdd_ref x, size_t op);
+	static bool shiftable(bdd_ref x, size_t op);
+	static bdd_ref ex_perm_shift(bdd_ref r, size_t op);
+	static bdd_ref bdd_ex_shift(bdd_ref x, size_t op);
+	static bdd_ref from_keys(const uint64_t* k, size_t n, size_t words,
+		bdd_shft nvars);
+	static bool save(const std::string& fn, const bdds& roots);
+	static bool load(const std::string& fn, bdds& roots);
 	static bool solve(bdd_ref x, bdd_shft v, bdd_ref& l, bdd_ref& h);
 	static void mark_all(bdd_ref i);
 	static size_t bdd_and_many_iter(bdds, bdds&, bdds&, bdd_ref&, bdd_shft&);
@@ -358,6 +636,11 @@ class bdd {
 	static bdd_ref bdd_and_ex_perm(bdd_ref x, bdd_ref y, const bools& ex,
 		const bdd_shfts&);
 	static bdd_ref bdd_and_many_ex_perm(bdds v, const bools&, const bdd_shfts&);
+	static bdd_ref bdd_and_ex_perm(bdd_ref x, bdd_ref y, size_t op);
+	static bdd_ref bdd_and_many_ex_perm(bdds v, size_t op);
+	static bdd_ref bdd_and_many_sched(bdds v, size_t op);
+	static void bdd_support(bdd_ref x, bools& s,
+		std::unordered_set<bdd_ref>& seen);
 	static void sat(bdd_shft v, bdd_shft nvars, bdd_ref t, bools& p, vbools& r);
 	static vbools allsat(bdd_ref x, bdd_shft nvars);
 	static void bdd_sz(bdd_ref x, std::set<bdd_ref>& s);
@@ -365,8 +648,18 @@ class bdd {
 	static bdd_shft bdd_nvars(bdd_ref x);
 	static bool bdd_subsumes(bdd_ref x, bdd_ref y);
 	static bdd_ref add(bdd_shft v, bdd_ref h, bdd_ref l);
+	// Fails unless a reference can hold the shift of variable v
+	inline static void check_var(size_t v) {
+#ifdef BDD_COMPACT_REFS
+		if (v >> (BDD_SHIFT_END - BDD_ID_BITS)) throw std::overflow_error(
+			"BDD variables exceed the shift bits left by BDD_ID_BITS, "
+			"build with a smaller one or without compact BDD "
+			"references");
+#else
+		(void)v;
+#endif
+	}
 	inline static bdd_ref from_bit(bdd_shft b, bool v);
-	inline static void max_bdd_size_check();
 	inline static bool leaf(bdd_ref t) { return BDD_ABS(t) == T; }
 	inline static bool trueleaf(bdd_ref t) { return !GET_INV_OUT(t); }
 	template <typename T>
@@ -411,7 +704,10 @@ class bdd {
 			t_pathv &path_a, t_pathv &path_b, t_pathv &pathX_a, t_pathv &pathX_b);
 	static bdd_ref merge_pathX(size_t i, size_t bits, bool carry, size_t n_args, size_t depth,
 			t_pathv &path_a, t_pathv &path_b, t_pathv &pathX_a, t_pathv &pathX_b);
-	static void satcount_arith(bdd_ref a_in, size_t bit, size_t bits, size_t factor, size_t &count);
+	static big_uint satcount_exact(bdd_ref x, bdd_shft nvars,
+		std::unordered_map<bdd_ref, big_uint>& memo);
+	static double satcount_log2(bdd_ref x, bdd_shft nvars,
+		std::unordered_map<bdd_ref, double>& memo);
 	static bdd_ref zero(size_t arg, size_t bits, size_t n_args);
 	static bool is_zero(bdd_ref a_in, size_t bits);
 	static void adder_be(bdd_ref a_in, bdd_ref b_in, size_t bits, size_t depth,
@@ -437,11 +733,15 @@ public:
 	static void init();
 #endif
 	static void gc();
+	static void gc_check();
 	template <typename T>
 	static std::basic_ostream<T>& stats(std::basic_ostream<T>& os);
 	static size_t get_ite_cache_size();
 	static void set_gc_limit(size_t new_gc_limit);
 	static void set_gc_enabled(bool new_gc_enabled);
+#ifdef WITH_THREADS
+	static void set_threads(size_t n) { threads = n ? n : 1; }
+#endif
 
 	/* Return the absolute BDD corresponding to the high part of the given BDD
 	 * reference. If x represents a boolean function f, then this function returns
@@ -470,19 +770,42 @@ public:
 	static bdd_shft getvar(bdd_ref x);
 };
 
+/* A handle keeping a BDD alive. Handles are what the garbage collector takes
+ * for roots and, unlike bare BDD references, survive it. A handle is a BDD
+ * reference along with a count, in R, of the handles held on its BDD ID, so
+ * copying one only bumps a plain counter and the roots are the IDs whose
+ * count is nonzero. Handles keep the interface of the pointers they once were:
+ * ->b is the BDD, a default constructed handle is null, and handles compare
+ * and order as their BDD references do. Terminals are not counted, they are never freed. */
 class bdd_handle {
 	friend class bdd;
-	bdd_handle(bdd_ref b) : b(b) { }//bdd::mark(b); }
-	static void update(const std::vector<bdd_id>& p);
-	static std::unordered_map<bdd_ref, std::weak_ptr<bdd_handle>> M;
+	static std::vector<uint32_t> R;
+	void incr() const { if (GET_BDD_ID(b) > 1) ++R[GET_BDD_ID(b)]; }
+	void decr() const {
+		if (GET_BDD_ID(b) > 1 && !onexit) --R[GET_BDD_ID(b)];
+	}
 public:
-	bdd_ref b;
+	bdd_ref b = 0;
+	bdd_handle() { }
+	bdd_handle(std::nullptr_t) { }
+	bdd_handle(const bdd_handle& h) : b(h.b) { incr(); }
+	bdd_handle(bdd_handle&& h) noexcept : b(h.b) { h.b = 0; }
+	~bdd_handle() { decr(); }
+	bdd_handle& operator=(bdd_handle h) noexcept {
+		return std::swap(b, h.b), *this;
+	}
+	const bdd_handle* operator->() const { return this; }
+	explicit operator bool() const { return b != 0; }
+	bool operator==(const bdd_handle& h) const { return b == h.b; }
+	bool operator!=(const bdd_handle& h) const { return b != h.b; }
+	bool operator<(const bdd_handle& h) const { return b < h.b; }
 	static spbdd_handle get(bdd_ref b);
 	static spbdd_handle T, F;
-	~bdd_handle() {
-		if (onexit) return;
-		//if (abs(b) > 1 && (M.erase(b), !has(M, -b))) bdd::unmark(b);
-		if (GET_BDD_ID(b) > 1) M.erase(b);//, !has(M, -b))) bdd::unmark(b);
+};
+
+template<> struct std::hash<bdd_handle> {
+	size_t operator()(const bdd_handle& h) const {
+		return std::hash<bdd_ref>()(h.b);
 	}
 };
 
@@ -501,4 +824,89 @@ private:
 	void sat(bdd_ref x);
 };
 
+/* Enumerates the satisfying assignments of a BDD over the variables 1..nvars
+ * in the same order as allsat_cb, but walks the BDD with an explicit stack and
+ * expands the trailing don't care variables of each cube with a counter
+ * instead of descending into the true leaf once per assignment. Assignments
+ * are packed into ncols integer columns: variable v adds w[v-1] to column
+ * c[v-1] when set. Full batches of rows are handed to the sink as
+ * sink(cols, n), where cols[k] points to the n values of column k. No memory
+ * is allocated after construction. */
 
+template <typename Sink> class allsat_batch {
+public:
+	allsat_batch(cr_spbdd_handle r, bdd_shft nvars, std::vector<size_t> c,
+		std::vector<int_t> w, size_t ncols, Sink& sink,
+		size_t batch = 1024) : r(r->b), nvars(nvars), c(std::move(c)),
+		w(std::move(w)), sink(sink), batch(batch), buf(ncols * batch),
+		cols(ncols), p(nvars + 1), val(ncols) {
+		DBG(assert(this->c.size() >= nvars && this->w.size() >= nvars);)
+		for (size_t k = 0; k != ncols; ++k) cols[k] = &buf[k * batch];
+		s.reserve(nvars + 2);
+	}
+	void operator()() {
+		if (r == F) return;
+		for (s.push_back({ r, 1, false }); !s.empty();) {
+			const frame f = s.back();
+			s.pop_back();
+			// Entering a node assigns the variable just above it
+			if (f.v > 1) p[f.v - 1] = f.val;
+			if (bdd::leaf(f.x)) { cube(f.v); continue; }
+			bdd_ref h = f.x, l = f.x;
+			// A skipped variable is a don't care, so both of its values lead
+			// to the same node
+			DBG(assert(bdd::var(f.x) <= nvars);)
+			if (f.v == bdd::var(f.x)) {
+				const bdd b = bdd::get(f.x);
+				h = b.h, l = b.l;
+			}
+			// Push the low branch first so that the high branch comes first
+			if (l != F) s.push_back({ l, f.v + 1, false });
+			if (h != F) s.push_back({ h, f.v + 1, true });
+		}
+		if (n) sink(cols.data(), n), n = 0;
+	}
+private:
+	struct frame {
+		bdd_ref x;
+		bdd_shft v;
+		bool val;
+	};
+	bdd_ref r;
+	const bdd_shft nvars;
+	const std::vector<size_t> c;
+	const std::vector<int_t> w;
+	Sink& sink;
+	const size_t batch;
+	std::vector<int_t> buf;
+	std::vector<int_t*> cols;
+	std::vector<frame> s;
+	// The current assignment, indexed by variable
+	bools p;
+	// The column values of the current assignment
+	std::vector<int_t> val;
+	size_t n = 0;
+
+	void row() {
+		for (size_t k = 0; k != cols.size(); ++k) cols[k][n] = val[k];
+		if (++n == batch)
+			sink(cols.data(), n), n = 0;
+	}
+	// Emits all assignments extending the path to a true leaf, where the
+	// variables from..nvars are don't cares. They count down from all set to
+	// match the order of allsat_cb.
+	void cube(bdd_shft from) {
+		std::fill(val.begin(), val.end(), 0);
+		for (bdd_shft v = 1; v != from; ++v) if (p[v]) val[c[v-1]] += w[v-1];
+		for (bdd_shft v = from; v <= nvars; ++v)
+			p[v] = true, val[c[v-1]] += w[v-1];
+		for (bdd_shft v;;) {
+			row();
+			for (v = nvars; v >= from && !p[v]; --v)
+				p[v] = true, val[c[v-1]] += w[v-1];
+			if (v < from) return;
+			p[v] = false, val[c[v-1]] -= w[v-1];
+		}
+	}
+};
+#endif
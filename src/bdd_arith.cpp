@@ -38,12 +38,20 @@ spbdd_handle bdd_not(cr_spbdd_handle x) {
 }
 
 size_t satcount(cr_spbdd_handle x, const size_t bits) {
-	bdd_shft av = GET_SHIFT(x->b);
-	size_t cnt = 0;
-	size_t factor = x->b != T ? pow(2,av-1) : 1;
-	size_t bit = (x->b != T && x->b != F) ? (av)-1 : 0;
-	bdd::satcount_arith(x->b, bit, bits, factor, cnt);
-	return cnt;
+	uint64_t r;
+	return satcount_exact(x, bits).get(r, SIZE_MAX) ? r : SIZE_MAX;
+}
+
+big_uint satcount_exact(cr_spbdd_handle x, const size_t bits) {
+	unordered_map<bdd_ref, big_uint> memo;
+	big_uint r = bdd::satcount_exact(x->b, bits, memo);
+	return r <<= bdd::leaf(x->b) ? bits : bdd::var(x->b) - 1;
+}
+
+double satcount_log2(cr_spbdd_handle x, const size_t bits) {
+	unordered_map<bdd_ref, double> memo;
+	return bdd::satcount_log2(x->b, bits, memo) +
+		(bdd::leaf(x->b) ? bits : bdd::var(x->b) - 1);
 }
 
 //------------------------------------------------------------------------------
@@ -138,23 +146,43 @@ bdd_ref bdd::bdd_quantify(bdd_ref x, uint_t bit, const std::vector<quant_t> &qua
 	return F;
 }
 
-void bdd::satcount_arith(bdd_ref a, size_t bit, size_t bits, size_t factor,
-		size_t &count) {
-	bdd ab = bdd::get(a);
-	bdd_shft av = GET_SHIFT(a);
-	if (ab.h == F && ab.l == F) return;
-	if (ab.h == T && ab.l == T) {
-		count = count + factor * pow(2, bits-bit); return;
-	}
-	if (ab.h != F) {
-		size_t delta = ab.h != T ? pow(2, GET_SHIFT(ab.h) - av - 1) : 1;
-		satcount_arith(ab.h, av, bits, factor * delta, count);
-	}
-	if (ab.l != F) {
-		size_t delta = ab.l != T ? pow(2, GET_SHIFT(ab.l) - av - 1) : 1;
-		satcount_arith(ab.l, av, bits, factor * delta, count);
-	}
-	return;
+/* Count the assignments to the variables var(x)..nvars that satisfy x. Each
+ * child's count is scaled by the variables skipped between x and the child.
+ * Counts are memoized per attributed reference, so shared subgraphs are
+ * visited once and complemented references at most twice. */
+
+big_uint bdd::satcount_exact(bdd_ref x, bdd_shft nvars,
+	unordered_map<bdd_ref, big_uint>& memo)
+{
+	if (leaf(x)) return x == T ? 1 : 0;
+	auto it = memo.find(x);
+	if (it != memo.end()) return it->second;
+	DBG(assert(var(x) <= nvars);)
+	const bdd b = get(x);
+	big_uint h = satcount_exact(b.h, nvars, memo),
+		l = satcount_exact(b.l, nvars, memo);
+	h <<= (leaf(b.h) ? nvars + 1 : var(b.h)) - var(x) - 1;
+	l <<= (leaf(b.l) ? nvars + 1 : var(b.l)) - var(x) - 1;
+	return memo.emplace(x, h += l).first->second;
+}
+
+/* The same recursion as satcount_exact carried out on base 2 logarithms. */
+
+double bdd::satcount_log2(bdd_ref x, bdd_shft nvars,
+	unordered_map<bdd_ref, double>& memo)
+{
+	if (leaf(x)) return x == T ? 0 : -INFINITY;
+	auto it = memo.find(x);
+	if (it != memo.end()) return it->second;
+	const bdd b = get(x);
+	double h = satcount_log2(b.h, nvars, memo) +
+			((leaf(b.h) ? nvars + 1 : var(b.h)) - var(x) - 1),
+		l = satcount_log2(b.l, nvars, memo) +
+			((leaf(b.l) ? nvars + 1 : var(b.l)) - var(x) - 1);
+	if (h < l) swap(h, l);
+	// log2(2^h + 2^l) computed without leaving the log domain
+	return memo.emplace(x, isinf(l) ? h :
+		h + log2(1 + exp2(l - h))).first->second;
 }
 
 /*
@@ -408,7 +436,6 @@ template<typename T> struct veccmp {
 		return x < y;
 	}
 };
-extern map<uints, unordered_map<bdd_ref, bdd_ref>, veccmp<uint_t>> memos_perm;
 // ----------------------------------------------------------------------------
 std::map<size_t, bdd_ref> covered_cf;
 std::map<size_t, bdd_ref> covered_ct;
@@ -1089,7 +1116,7 @@ bdd_ref bdd::shlx(bdd_ref b_in, size_t x, size_t bits, size_t n_args) {
 			perm1[n_args*i+1] = perm1[n_args*(i+x)+1];
 		}
 	}
-	bdd_ref aux = bdd_permute(b_in, perm1, memos_perm[perm1]);
+	bdd_ref aux = bdd_permute(b_in, perm1, perm_memo(perm1));
 	bdd_ref aux_b = aux;
 	for (size_t i = 0; i < x ; i++) {
 		aux_b = add((n_args*(x-i-1))+2,F,aux_b);
@@ -1113,14 +1140,19 @@ bdd_ref bdd::shr(bdd_ref a_in, size_t arg, size_t bits, size_t n_args) {
 	for (size_t i = 1; n_args*i+base < tbits ; i++) {
 		perm1[n_args*i+base] = perm1[n_args*i+base]-n_args;
 	}
-	a_in = bdd_permute(a_in, perm1, memos_perm[perm1]);
+	a_in = bdd_permute(a_in, perm1, perm_memo(perm1));
 	size_t pos_z = n_args * (bits-1) + base + 1;
 	bdd_ref aux_bit = add(pos_z,F,T);
 	a_in = bdd_and(a_in, aux_bit);
 	return a_in;
 }
 
-bdd_ref bdd::bdd_shift(bdd_ref a_in, bdd_shft amt) { return PLUS_SHIFT(a_in, amt); }
+bdd_ref bdd::bdd_shift(bdd_ref a_in, bdd_shft amt) {
+#ifdef BDD_COMPACT_REFS
+	if (!leaf(a_in)) check_var(bdd_nvars(a_in) + 1 + amt);
+#endif
+	return PLUS_SHIFT(a_in, amt);
+}
 
 bdd_ref bdd::copy_arg2arg(bdd_ref a , size_t arg_a, size_t arg_b, size_t bits,
 	size_t n_args) {
@@ -1130,7 +1162,7 @@ bdd_ref bdd::copy_arg2arg(bdd_ref a , size_t arg_a, size_t arg_b, size_t bits,
 		//COUT << perm[i*n_args + arg_a]+1 << " --- " << i*n_args + arg_b +1 << "\n";
 		perm[i*n_args + arg_a] = i*n_args + arg_b;
 	}
-	b = bdd_permute(a, perm, memos_perm[perm]);
+	b = bdd_permute(a, perm, perm_memo(perm));
 	return b;
 }
 
@@ -1172,11 +1204,11 @@ bdd_ref bdd::adder_accs(bdd_ref b_in, bdd_ref acc, size_t depth, size_t bits,
 	if (is_zero(acc_aux, ext_bits))
 		aux = copy_arg2arg(b_aux, 1,2,ext_bits, n_args);
 	else {
-		b_aux = bdd_permute(b_aux, perm1, memos_perm[perm1]);
+		b_aux = bdd_permute(b_aux, perm1, perm_memo(perm1));
 		//COUT << "##[baux inv]:" << endl;
 		//out(COUT, b_aux);
 		//COUT <<endl<<endl;
-		acc_aux = bdd_permute(acc_aux, perm1, memos_perm[perm1]);
+		acc_aux = bdd_permute(acc_aux, perm1, perm_memo(perm1));
 		//COUT << "##[acc_aux inv]:" << endl;
 		//out(COUT, acc_aux);
 		//COUT <<endl<<endl;
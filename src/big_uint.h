@@ -0,0 +1,93 @@
+// LICENSE
+// This software is free for use and redistribution while including this
+// license notice, unless:
+// 1. is used for commercial or non-personal purposes, or
+// 2. used for a product which includes or associated with a blockchain or other
+// decentralized database technology, or
+// 3. used for a product which includes or associated with the issuance or use
+// of cryptographic or electronic currencies/coins/tokens.
+// On all of the mentioned cases, an explicit and written permission is required
+// from the Author (Ohad Asor).
+// Contact ohad@idni.org for requesting a permission. This license may be
+// modified over time by the Author.
+#ifndef __BIG_UINT_H__
+#define __BIG_UINT_H__
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <ostream>
+
+// An arbitrary precision unsigned integer supporting just what model counting
+// needs: addition, shifting left, and conversion.
+struct big_uint {
+	// Little endian 32 bit limbs without leading zero limbs. Zero is empty.
+	std::vector<uint32_t> d;
+
+	big_uint(uint64_t x = 0) {
+		while (x) d.push_back((uint32_t)x), x >>= 32;
+	}
+
+	big_uint& operator+=(const big_uint& y) {
+		if (d.size() < y.d.size()) d.resize(y.d.size(), 0);
+		uint64_t c = 0;
+		for (size_t n = 0; n != d.size() && (c || n < y.d.size()); ++n)
+			c += (uint64_t)d[n] + (n < y.d.size() ? y.d[n] : 0),
+			d[n] = (uint32_t)c, c >>= 32;
+		if (c) d.push_back((uint32_t)c);
+		return *this;
+	}
+
+	big_uint& operator<<=(size_t s) {
+		if (d.empty() || !s) return *this;
+		if (const size_t b = s % 32) {
+			uint32_t c = 0, t;
+			for (uint32_t& x : d) t = x >> (32 - b), x = (x << b) | c, c = t;
+			if (c) d.push_back(c);
+		}
+		return d.insert(d.begin(), s / 32, 0), *this;
+	}
+
+	bool operator==(const big_uint& y) const { return d == y.d; }
+	bool operator!=(const big_uint& y) const { return d != y.d; }
+
+	// Stores the value in r and returns true if it is at most max
+	bool get(uint64_t& r, uint64_t max = UINT64_MAX) const {
+		if (d.size() > 2) return false;
+		r = d.empty() ? 0 : d[0];
+		if (d.size() == 2) r |= (uint64_t)d[1] << 32;
+		return r <= max;
+	}
+
+	// The nearest double, or infinity if the value is out of range
+	double to_double() const {
+		double r = 0;
+		for (size_t n = d.size(); n--;) r = std::ldexp(r, 32) + d[n];
+		return r;
+	}
+
+	std::string to_string() const {
+		if (d.empty()) return "0";
+		std::vector<uint32_t> q = d;
+		std::string s;
+		// Repeatedly divide by 10^9, emitting nine digits per remainder
+		while (!q.empty()) {
+			uint64_t r = 0;
+			for (size_t n = q.size(); n--;)
+				r = (r << 32) | q[n], q[n] = (uint32_t)(r / 1000000000),
+				r %= 1000000000;
+			while (!q.empty() && !q.back()) q.pop_back();
+			for (size_t k = 0; k != 9 && (r || !q.empty()); ++k)
+				s.push_back('0' + r % 10), r /= 10;
+		}
+		return std::reverse(s.begin(), s.end()), s;
+	}
+};
+
+template <typename T>
+std::basic_ostream<T>& operator<<(std::basic_ostream<T>& os, const big_uint& x){
+	for (char c : x.to_string()) os << (T)c;
+	return os;
+}
+#endif
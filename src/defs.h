@@ -115,7 +115,7 @@ enum proof_mode { none, tree, forest, partial_tree, partial_forest };
 typedef struct {
 	bool optimize, print_transformed, apply_regexpmatch, fp_step,
 		show_hidden, bin_lr, incr_gen_forest,
-		binarize = true, print_binarized = false;
+		binarize = true, print_binarized = false, semi_naive = true;
 	enum proof_mode bproof;
 	size_t bitorder;
 	std::set<ntable> pu_states;
@@ -134,7 +134,7 @@ struct body;
 struct pnf_t;
 typedef enum {EX, UN, FA, EXH, UNH, FAH} quant_t;
 typedef std::map<int_t, size_t> varmap;
-typedef std::shared_ptr<class bdd_handle> spbdd_handle;
+typedef class bdd_handle spbdd_handle;
 typedef std::shared_ptr<form> spform_handle;
 typedef const spform_handle& cr_spform_handle;
 
@@ -11,43 +11,141 @@
 // Contact ohad@idni.org for requesting a permission. This license may be
 // modified over time by the Author.
 #include <cstring>
+#include <fstream>
 #include "defs.h"
 #include "dict.h"
 #include "err.h"
 #include "input.h"
+#include "memory_map.h"
 using namespace std;
 
+size_t lexeme_map::hash(const lexeme& l) {
+	const size_t n = l[1] - l[0];
+	uint64_t h = n * 0x9e3779b97f4a7c15ull, w;
+	size_t k = 0;
+	for (; k + 8 <= n; k += 8)
+		memcpy(&w, l[0] + k, 8), h = (h ^ w) * 0xff51afd7ed558ccdull,
+		h ^= h >> 32;
+	for (w = 0; k != n; ++k) w = (w << 8) | (unsigned char) l[0][k];
+	h = (h ^ w) * 0xc4ceb9fe1a85ec53ull;
+	return h ^ (h >> 29);
+}
+
+void lexeme_map::rehash(size_t cap) {
+	slots.assign(cap, 0);
+	for (size_t id = 0; id != keys.size(); ++id) {
+		size_t i = hashes[id] & (cap - 1);
+		while (slots[i]) i = (i + 1) & (cap - 1);
+		slots[i] = id + 1;
+	}
+}
+
+void lexeme_map::reserve(size_t n) {
+	keys.reserve(n), hashes.reserve(n);
+	size_t cap = slots.size() ? slots.size() : 16;
+	while (cap / 4 * 3 < n) cap <<= 1;
+	if (cap != slots.size()) rehash(cap);
+}
+
+int_t lexeme_map::find(const lexeme& l) const {
+	if (slots.empty()) return -1;
+	const size_t h = hash(l), m = slots.size() - 1, n = l[1] - l[0];
+	for (size_t i = h & m; slots[i]; i = (i + 1) & m) {
+		const uint32_t id = slots[i] - 1;
+		if (hashes[id] == h && (size_t)(keys[id][1] - keys[id][0]) == n
+			&& !memcmp(keys[id][0], l[0], n)) return id;
+	}
+	return -1;
+}
+
+pair<int_t, bool> lexeme_map::insert(const lexeme& l) {
+	int_t id = find(l);
+	if (id != -1) return { id, false };
+	if (slots.size() / 4 * 3 <= keys.size()) reserve(keys.size() + 1);
+	const size_t h = hash(l), m = slots.size() - 1;
+	size_t i = h & m;
+	while (slots[i]) i = (i + 1) & m;
+	slots[i] = keys.size() + 1, keys.push_back(l), hashes.push_back(h);
+	return { keys.size() - 1, true };
+}
+
+ccs str_arena::copy(ccs s, size_t n) {
+	if (left < n + 1) {
+		const size_t sz = max(n + 1, (size_t) 1 << 16);
+		blocks.emplace_back(new char[sz]);
+		cur = blocks.back().get(), left = sz;
+	}
+	char* r = cur;
+	memcpy(r, s, n), r[n] = 0, cur += n + 1, left -= n + 1;
+	return (ccs) r;
+}
+
 dict_t::dict_t() {}
-dict_t::~dict_t() { for (auto x : strs_allocated) free((char *)x); }
+dict_t::~dict_t() {}
 
 int_t dict_t::get_var(const lexeme& l) {
-	auto it = vars_dict.find(l);
-	if (it != vars_dict.end()) return it->second;
-	int_t r = -vars_dict.size() - 1;
-	vars.push_back(l);
-	return vars_dict[l] = r;
+	return -vars.insert(l).first - 1;
 }
 
 int_t dict_t::get_rel(const lexeme& l) {
-	auto it = rels_dict.find(l);
-	if (it != rels_dict.end()) return it->second;
-	rels.push_back(l);
-	return rels_dict[l] = rels.size() - 1;
+	return rels.insert(l).first;
 }
 
 int_t dict_t::get_sym(const lexeme& l) {
-	auto it = syms_dict.find(l);
-	if (it != syms_dict.end()) return it->second;
-	syms.push_back(l);
-	return syms_dict[l] = syms.size()-1;
+	return syms.insert(l).first;
 }
 
 int_t dict_t::get_bltin(const lexeme& l) {
 	if (*l[0] == '?') parse_error(err_var_relsym, l);
-	auto it = bltins_dict.find(l);
-	if (it != bltins_dict.end()) return it->second;
-	bltins.push_back(l);
-	return bltins_dict[l] = bltins.size() - 1;
+	return bltins.insert(l).first;
+}
+
+/* The symbols file is "TMLD", a 32 bit version and symbol count, and then
+ * per symbol its 32 bit length followed by its bytes and a null. All
+ * integers are in host byte order. */
+
+bool dict_t::save(const string& fname) const {
+	ofstream os(fname, ios::binary);
+	if (!os) return o::err() << "Cannot open " << fname << endl, false;
+	auto put = [&os](uint32_t x) { os.write((const char*)&x, sizeof x); };
+	os.write("TMLD", 4), put(1), put(syms.size());
+	for (size_t n = 0; n != syms.size(); ++n)
+		put(syms[n][1] - syms[n][0]),
+		os.write((const char*) syms[n][0], syms[n][1] - syms[n][0]),
+		os.put(0);
+	return (bool) os;
+}
+
+bool dict_t::load(const string& fname) {
+	unique_ptr<memory_map> m(new memory_map(fname));
+	auto fail = [&fname](const char* msg) {
+		return o::err() << fname << ": " << msg << endl, false;
+	};
+	if (m->error) return fail("cannot map");
+	ccs p = (ccs) m->data(), e = p + m->size();
+	uint32_t x;
+	auto get = [&p, e, &x]() {
+		if ((size_t)(e - p) < sizeof x) return false;
+		return memcpy(&x, p, sizeof x), p += sizeof x, true;
+	};
+	if (!p || m->size() < 4 || memcmp(p, "TMLD", 4))
+		return fail("not a symbols file");
+	p += 4;
+	if (!get() || x != 1) return fail("unsupported version");
+	if (!get()) return fail("truncated");
+	// The symbols point into the mapping, so check the whole file before
+	// inserting any of them, lest they outlive a mapping that failed
+	const size_t count = x;
+	const ccs syms_begin = p;
+	for (size_t n = count; n--; p += x + 1)
+		if (!get() || (size_t)(e - p) < (size_t) x + 1)
+			return fail("truncated");
+	reserve_syms(count);
+	p = syms_begin;
+	for (size_t n = count; n--; p += x + 1)
+		get(), syms.insert({ p, p + x });
+	mms.push_back(move(m));
+	return true;
 }
 
 int_t dict_t::get_new_sym() {
@@ -83,13 +181,10 @@ ints dict_t::get_rels(function<bool(const lexeme&)> filter) {
 
 lexeme dict_t::get_lexeme(ccs w, size_t l) {
 	if (l == (size_t)-1) l = strlen(w);
-	auto it = strs_extra.find({ w, w + l });
-	if (it != strs_extra.end()) return *it;
-	cstr r = strdup(w);
-	strs_allocated.push_back(r);
-	lexeme lx = { r, r + l };
-	strs_extra.insert(lx);
-	return lx;
+	int_t id = strs.find({ w, w + l });
+	if (id != -1) return strs[id];
+	ccs r = arena.copy(w, l);
+	return strs[strs.insert({ r, r + l }).first];
 }
 lexeme dict_t::get_lexeme(const std::basic_string<unsigned char>& s) {
 	ccs w = s.c_str();
@@ -103,9 +198,7 @@ lexeme dict_t::get_lexeme(const std::basic_string<char>& s) {
 //---
 
 int_t dict_t::get_temp_sym(const lexeme& l) {
-	auto it = temp_syms_dict.find(l);
-	if (it != temp_syms_dict.end()) return it->second;
-	return temp_syms.push_back(l), temp_syms_dict[l] = (temp_syms.size());
+	return temp_syms.insert(l).first + 1;
 }
 
 int_t dict_t::get_fresh_temp_sym() {
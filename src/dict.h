@@ -14,20 +14,59 @@
 #define __DICT_H__
 #include "defs.h"
 #include <map>
+#include <memory>
 #include <functional>
 
+// Interns lexemes by their bytes, numbering them 0, 1, ... in the order they
+// are added. An open addressing hash table with linear probing whose slots
+// hold the ids, so lookups hash the lexeme once and compare bytes only on a
+// match of the full hash.
+class lexeme_map {
+	std::vector<lexeme> keys;
+	std::vector<size_t> hashes;
+	std::vector<uint32_t> slots; // id + 1, or 0 when empty
+	static size_t hash(const lexeme& l);
+	void rehash(size_t cap);
+public:
+	// Returns the id of l or -1 if l was not added
+	int_t find(const lexeme& l) const;
+	// Returns the id of l and whether it was added by this call
+	std::pair<int_t, bool> insert(const lexeme& l);
+	void reserve(size_t n);
+	size_t size() const { return keys.size(); }
+	const lexeme& operator[](size_t id) const { return keys[id]; }
+};
+
+// Bump pointer allocator for the dictionary's own strings. Strings are never
+// freed individually and keep their addresses until the arena is destroyed.
+class str_arena {
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char* cur = 0;
+	size_t left = 0;
+public:
+	// Copies the n bytes at s followed by a null and returns the copy
+	ccs copy(ccs s, size_t n);
+};
+
 class inputs;
+class memory_map;
 class dict_t {
-	typedef std::map<lexeme, int_t, lexcmp> dictmap;
-	dictmap syms_dict, vars_dict, rels_dict, bltins_dict, temp_syms_dict;
-	std::vector<lexeme> syms, vars, rels, bltins, temp_syms;
-	std::set<lexeme, lexcmp> strs_extra;
-	std::vector<ccs> strs_allocated;
+	lexeme_map syms, vars, rels, bltins, temp_syms, strs;
+	str_arena arena;
+	// back the lexemes loaded by load()
+	std::vector<std::unique_ptr<memory_map>> mms;
 	inputs* ii = 0;
 public:
 	dict_t();
 	~dict_t();
 	void set_inputs(inputs* ins) { ii = ins; }
+	// Reserves room for n more symbols ahead of a bulk load
+	void reserve_syms(size_t n) { syms.reserve(syms.size() + n); }
+	// Saves the symbols to fname, so that load() assigns them the same ids
+	bool save(const std::string& fname) const;
+	// Adds the symbols saved in fname, pointing to them in a memory mapping
+	// of the file rather than copying them
+	bool load(const std::string& fname);
 
 	int_t get_sym(const lexeme& l);
 	int_t get_var(const lexeme& l);
@@ -38,7 +77,7 @@ public:
 	const lexeme& get_rel_lexeme(int_t t) const { return rels[t]; }
 	const lexeme& get_bltin_lexeme(int_t t) const { return bltins[t]; }
 	size_t nsyms() const { return syms.size(); }
-	size_t nvars() const { return vars_dict.size(); }
+	size_t nvars() const { return vars.size(); }
 	size_t nrels() const { return rels.size(); }
 	size_t nbltins() const { return bltins.size(); }
 
@@ -53,11 +92,7 @@ public:
 	int_t get_new_var();
 	int_t get_new_rel();
 
-	bool is_bltin(const lexeme& l) const {
-		auto it = bltins_dict.find(l);
-		if (it != bltins_dict.end()) return true;
-		return false;
-	}
+	bool is_bltin(const lexeme& l) const { return bltins.find(l) != -1; }
 
 	ints get_rels(std::function<bool(const lexeme&)> filter = nullptr);
 
@@ -3761,6 +3761,7 @@ driver::driver(string s, const options &o) : opts(o), rp(raw_progs(dict)) {
 	to.bin_lr            = opts.enabled("bin-lr");
 	to.bitorder          = opts.get_int("bitorder");
 	to.incr_gen_forest	 = opts.enabled("incr-gen-forest");
+	to.semi_naive        = opts.enabled("semi-naive");
 
 	//dict belongs to driver and is referenced by ir_builder and tables
 	ir = new ir_builder(dict, to);
@@ -3774,7 +3775,16 @@ driver::driver(string s, const options &o) : opts(o), rp(raw_progs(dict)) {
 	set_populate_tml_update(opts.enabled("tml_update"));
 	set_regex_level(opts.get_int("regex-level"));
 
-	read_inputs();
+	if (opts.get_string("load-dict").size() &&
+		!dict.load(opts.get_string("load-dict"))) error = true;
+	if (!error) read_inputs();
+	// bulk load the comma separated list of files given by -load
+	const string load = opts.get_string("load");
+	for (size_t b = 0, e; !error && b < load.size(); b = e + 1) {
+		if ((e = load.find(',', b)) == string::npos) e = load.size();
+		if (e != b && !tbl->load_facts(load.substr(b, e - b)))
+			error = true;
+	}
 	if(!error) {
 		//FIXME: root_isempty
 		directives_load((rp.p.nps)[0]);
@@ -233,6 +233,11 @@ class driver {
 	std::set<lexeme> transformed_strings;
 	tables *tbl = 0;
 	ir_builder *ir = 0;
+	// the parser of tml programs, kept between parses so that parsing a
+	// program again, as the repl does after each change, redoes the chart
+	// from the first change only
+	std::unique_ptr<earley_t> tml_parser;
+	bool tml_parser_bin_lr = false;
 
 	std::set<lexeme> vars;
 	options opts;
@@ -297,6 +302,10 @@ public:
 	void dump() { out(o::dump()); }
 	void out(const tables::rt_printer& p) const { if (tbl) tbl->out(p); }
 	void save_csv() const;
+	void save_bin(const std::string& fname) const;
+	bool save_dict(const std::string& fname) const {
+		return dict.save(fname);
+	}
 	
 #ifdef __EMSCRIPTEN__
 	void out(emscripten::val o) const { if (tbl) tbl->out(o); }
@@ -216,7 +216,7 @@ template <typename CharT>
 typename earley<CharT>::ostream& earley<CharT>::print(
 	earley<CharT>::ostream& os, const item& i) const
 {
-	put(put(os, i.set) << " ", i.from) << " ";
+	put(put(os, (size_t) i.set) << " ", (size_t) i.from) << " ";
 	for (size_t n = 0; n != G[i.prod].size(); ++n) {
 		if (n == i.dot) os << "* ";
 		if (G[i.prod][n].nt()) put(os, d.get(G[i.prod][n].n())) << " ";
@@ -227,40 +227,86 @@ typename earley<CharT>::ostream& earley<CharT>::print(
 	return os;
 }
 
+// adds i to its set unless it is there already, returns whether it was added
 template <typename CharT>
-earley<CharT>::container_iter earley<CharT>::add(container_t& t, 
-		const item& i) {
+bool earley<CharT>::push(const item& i) {
+	const size_t k = dotted(i);
+	if (i.from == i.set) {
+		if (here.size() <= k) here.resize(2 * k + 1);
+		if (here[k]) return false;
+		here[k] = true;
+	} else if (!seen[i.set & 1].insert((uint64_t(i.from) << 32) | k))
+		return false;
+	S[i.set].push_back(i);
+	if (!completed(i) && get_lit(i).nt()) {
+		const size_t x = get_lit(i).n();
+		W[i.set][x].push_back(S[i.set].size() - 1);
+		// x already completed here with an empty span, as in a builtin
+		// matching the end of the input
+		if (i.set == cur && empty_done.find(x) != empty_done.end())
+			add(item(i.set, i.prod, i.from, i.dot + 1));
+	}
+	return true;
+}
+
+template <typename CharT>
+void earley<CharT>::add(const item& i) {
 	//DBG(print(o::dbg() << "adding ", i) << endl;)
-	auto& cont = S[i.set];
-	auto it = cont.find(i);
-	if (it != cont.end()) return it;
-	if ((it = t.find(i)) != t.end()) return it;
-	it = t.insert(i).first;
-	if (nullable(*it))
-		add(t, item(it->set, it->prod, it->from, it->dot + 1));
+	if (push(i) && nullable(i))
+		add(item(i.set, i.prod, i.from, i.dot + 1));
 			//->advancers.insert(i);
-	return it;
 }
 
 template <typename CharT>
-void earley<CharT>::complete(const item& i, container_t& t) {
+void earley<CharT>::complete(const item& i) {
 	//DBG(print(o::dbg() << "completing ", i) << endl;)
-	const container_t& cont = S[i.from];
-	for (auto it = cont.begin(); it != cont.end(); ++it)
-		if (G[it->prod].size() > it->dot &&
-			get_lit(*it) == get_nt(i))
-			add(t, item(i.set, it->prod, it->from, it->dot + 1));
+	const size_t x = get_nt(i).n();
+	if (i.from == i.set) empty_done.insert(x);
+	else if (const leo_t& t = leo(i.from, x); t.prod != none) {
+		leo_used[i.set].emplace_back(x, i.from);
+		add(item(i.set, t.prod, t.from, G[t.prod].size()));
+		return;
+	}
+	auto it = W[i.from].find(x);
+	if (it == W[i.from].end()) return;
+	// the vector grows meanwhile if i.from is the current set
+	const vector<uint32_t>& w = it->second;
+	for (size_t k = 0; k != w.size(); ++k) {
+		const item j = S[i.from][w[k]];
+		add(item(i.set, j.prod, j.from, j.dot + 1));
 				//completers.insert(i);
+	}
+}
+
+// the Leo item of x in a set which is done already
+template <typename CharT>
+const typename earley<CharT>::leo_t& earley<CharT>::leo(size_t set, size_t x)
+{
+	if (auto it = L[set].find(x); it != L[set].end()) return it->second;
+	leo_t t{ 0, none, 0 };
+	auto it = W[set].find(x);
+	if (it != W[set].end() && it->second.size() == 1) {
+		const item& j = S[set][it->second[0]];
+		if (j.dot + 1 == G[j.prod].size()) {
+			t = { it->second[0], j.prod, j.from };
+			// the chain goes on only to earlier sets, so it ends
+			if (j.from < set)
+				if (const leo_t& u = leo(j.from, get_nt(j).n());
+					u.prod != none) t.prod = u.prod, t.from = u.from;
+		}
+	}
+	return L[set].emplace(x, t).first->second;
 }
 
 template <typename CharT>
-void earley<CharT>::predict(const item& i, container_t& t) {
+void earley<CharT>::predict(const item& i) {
 	//DBG(print(o::dbg() << "predicting ", i) << endl;)
-	for (size_t p : nts[get_lit(i)]) {
-		item j(i.set, p, i.set, 1);
-		add(t, j); //->advancers.insert(i);
+	const size_t x = get_lit(i).n();
+	if (x >= nt_prods.size() || predicted[x] == i.set) return;
+	predicted[x] = i.set;
+	for (size_t p : nt_prods[x]) add(item(i.set, p, i.set, 1));
+		//->advancers.insert(i);
 		//DBG(print(o::dbg() << "predicting added ", j) << endl;)
-	}
 }
 
 template <typename CharT>
@@ -277,17 +323,14 @@ void earley<CharT>::scan_builtin(const item& i, size_t n, const string& s) {
 		G.back().push_back(lit{ ch });
 		builtin_char_prod[bid][ch] = p; // store prod of this ch
 	} else p = it->second; // this ch has its prod already
-	item j(n + !eof, i.prod, n, 2); // complete builtin
-	S[j.set].insert(j);
-	item k(n + !eof, p, n, 2);      // complete builtin's character
-	S[k.set].insert(k);
+	push(item(n + !eof, i.prod, n, 2)); // complete builtin
+	push(item(n + !eof, p, n, 2));      // complete builtin's character
 }
 
 template <typename CharT>
 void earley<CharT>::scan(const item& i, size_t n, CharT ch) {
 	if (ch != get_lit(i).c()) return;
-	item j(n + 1, i.prod, i.from, i.dot + 1);
-	S[j.set].insert(j);
+	push(item(n + 1, i.prod, i.from, i.dot + 1));
 	//first->advancers.insert(i);
 	//DBG(print(o::dbg(), i) << ' ';)
 	//DBG(print(o::dbg() << "scanned " << ch << " and added ", j) << "\n";)
@@ -301,46 +344,116 @@ void earley<CharT>::scan(const item& i, size_t n, CharT ch) {
 
 template <typename CharT>
 bool earley<CharT>::recognize(const typename earley<CharT>::string s) {
+	return parse(s, 0, false);
+}
+
+template <typename CharT>
+bool earley<CharT>::reparse(const typename earley<CharT>::string s) {
+	size_t from = 0;
+	if (chart) from = mismatch(s.begin(), s.end(), inputstr.begin(),
+		inputstr.end()).first - s.begin();
+	return parse(s, from, true);
+}
+
+// drops the sets from p on, and all that was found in them, but the items
+// scanned into S[p] from S[p - 1], which are added again
+template <typename CharT>
+void earley<CharT>::truncate(size_t p) {
+	const size_t len = inputstr.size();
+	S.resize(p), S.resize(len + 1), W.resize(p), W.resize(len + 1);
+	L.resize(p), L.resize(len + 1);
+	leo_used.resize(p), leo_used.resize(len + 1);
+	C.resize(p), C.resize(len + 1);
+	C_built.resize(p), C_built.resize(len + 1, false);
+	seen[0].clear(), seen[1].clear();
+	fill(predicted.begin(), predicted.end(), SIZE_MAX);
+	for (auto it = occ.begin(); it != occ.end(); ) {
+		vector<uint32_t>& v = it->second;
+		while (!v.empty() && v.back() >= p) v.pop_back();
+		if (v.empty()) it = occ.erase(it);
+		else ++it;
+	}
+	indexed = std::min(indexed, p);
+	// the nodes ending before p stay, and so do their children, which end
+	// before them
+	vector<uint32_t> id(fn.size(), none);
+	uint32_t m = 0;
+	for (size_t n = 0; n != fn.size(); ++n) if (fn[n].to < p) id[n] = m++;
+	vector<pair<uint32_t, uint32_t>> ps;
+	for (size_t n = 0; n != fn.size(); ++n) {
+		if (id[n] == none) continue;
+		fnode x = fn[n];
+		const size_t b = ps.size();
+		for (size_t k = x.pack; k != x.pack + x.npacks; ++k)
+			ps.emplace_back(fp[k].first == none ? none
+				: id[fp[k].first], id[fp[k].second]);
+		x.pack = b, fn[id[n]] = x;
+	}
+	fn.resize(m), fp.swap(ps), fid.clear();
+	cur = p - 1;
+	for (const item& i : S[p - 1])
+		if (completed(i)) continue;
+		else if (get_lit(i).is_builtin())
+			scan_builtin(i, p - 1, inputstr);
+		else if (!get_lit(i).nt()) scan(i, p - 1, inputstr[p - 1]);
+}
+
+// recognizes s going on from the set from, all sets before it being kept
+// from the last input, or from scratch if from is 0. W is freed at the end
+// unless keep.
+template <typename CharT>
+bool earley<CharT>::parse(const string& s, size_t from, bool keep) {
 	DBG(bool pms = o::enabled("parser-benchmarks");)
 	//DBG(o::dbg() << "recognizing: " << to_stdstr(s) << endl;)
 	emeasure_time_start(tsr, ter);
 	inputstr = s;
 	size_t len = s.size();
 	pfgraph.clear();
-	bin_tnt.clear();
-	tid = 0;
-	S.clear();//, S.resize(len + 1);//, C.clear(), C.resize(len + 1);
-	S.resize(len+1);
-	for (size_t n : nts[start]) {
-		auto& cont = S[0];
-		auto it = cont.emplace(0, n, 0, 1).first;
-		// fix the bug for missing Start( 0 0) when start is nulllable
-		if(nullable(*it))
-			cont.emplace(0, n, 0, 2);
+	if (from) truncate(from);
+	else {
+		temps.clear();
+		fn.clear(), fp.clear(), fid.clear(), occ.clear(), indexed = 0;
+		S.clear(), S.resize(len + 1), W.clear(), W.resize(len + 1);
+		L.clear(), L.resize(len + 1);
+		leo_used.clear(), leo_used.resize(len + 1);
+		skipped.clear(), skipped_ids.clear();
+		C.clear(), C.resize(len + 1), C_built.assign(len + 1, false);
+		dr = { 0 }, here.clear(), seen[0].clear(), seen[1].clear();
+		nt_prods.assign(d.v.size(), {}),
+		predicted.assign(d.v.size(), SIZE_MAX);
+		for (const auto& x : nts) if (x.first.nt())
+			nt_prods[x.first.n()].assign(x.second.begin(),
+				x.second.end());
+		for (size_t n : nts[start]) {
+			item i(0, n, 0, 1);
+			push(i);
+			// fix the bug for missing Start( 0 0) when start is
+			// nulllable
+			if(nullable(i))
+				push(item(0, n, 0, 2));
+		}
 	}
-	container_t t;
 #ifdef DEBUG
 	size_t r = 1, cb = 0; // row and cel beginning
 #endif
-	for (size_t n = 0; n != len + 1; ++n) {
+	for (size_t n = from; n != len + 1; ++n) {
 #ifdef DEBUG
 		if (s[n] == '\n') (cb = n), r++;
 		emeasure_time_start(tsp, tep);
 #endif
-		do {
-			for(const item &x : t) S[x.set].insert(x);
-			t.clear();
-			const auto& cont = S[n];
-			for (auto it = cont.begin();
-				it != cont.end(); ++it) {
-				//DBG(print(o::dbg() << "processing ", *it) << endl;)
-				if (completed(*it)) complete(*it, t);
-				else if (get_lit(*it).is_builtin()) {
-					if (n <= len) scan_builtin(*it, n, s);
-				} else if (get_lit(*it).nt()) predict(*it, t);
-				else if (n < len) scan(*it, n, s[n]);
-			}
-		} while (!t.empty());
+		cur = n;
+		// items are added to S[n] while it is processed
+		for (size_t k = 0; k != S[n].size(); ++k) {
+			const item i = S[n][k];
+			//DBG(print(o::dbg() << "processing ", i) << endl;)
+			if (completed(i)) complete(i);
+			else if (get_lit(i).is_builtin()) {
+				if (n <= len) scan_builtin(i, n, s);
+			} else if (get_lit(i).nt()) predict(i);
+			else if (n < len) scan(i, n, s[n]);
+		}
+		for (const item& i : S[n]) if (i.from == n) here[dotted(i)] = false;
+		seen[n & 1].clear(), empty_done.clear();
 #ifdef DEBUG
 		if (pms) {
 			o::pms()<<n<<" \tln: "<<r<<" col: "<<(n-cb+1)<<" :: ";
@@ -360,27 +473,23 @@ bool earley<CharT>::recognize(const typename earley<CharT>::string s) {
 #endif
 */
 		if (true == incr_gen_forest) {
-		DBG(o::dbg() << "set: " << n << endl;)
-		const auto& cont = S[n];
-		for (auto it = cont.begin(); it != cont.end(); ++it)
-			if(completed(*it)) pre_process(*it);
-			
-		for (auto it = cont.begin(); it != cont.end(); ++it)
-			if (completed(*it)) { 
-				DBG(o::dbg()<<endl<< it->from <<it->set << 
-					it->prod << it->dot <<endl);				
-				nidx_t curroot(get_nt(*it), {it->from, it->set});
-				build_forest(curroot);
-				//to_tml_rule(o::to("parser-to-rules"));
-			}
+			DBG(o::dbg() << "set: " << n << endl;)
+			label_prods(), index_items(n);
+			const size_t first = fn.size();
+			auto r = completions(n, none);
+			for (auto c = r.first; c != r.second; ++c)
+				fnode_id(sym_l[dr[c->prod]], c->from, n);
+			build_forest(first);
 		}
 	}
-	bool found = false;
-	for (size_t n : nts[start])
-		if (S[len].find( item(len, n, 0, G[n].size())) != S[len].end()) 
-			found = true;
+	if (!keep) W.clear(), W.shrink_to_fit();
+	chart = keep;
+	// the start may complete as skipped by a Leo item
+	auto rs = completions(len, start.n(), 0);
+	bool found = rs.first != rs.second;
 	emeasure_time_end(tsr, ter) <<" :: recognize time" <<endl;
 	if(!incr_gen_forest) forest();
+	else to_pfgraph();
 	ptree_t pt;
 	//this->get_parsed_tree();
 
@@ -716,114 +825,303 @@ bool earley<CharT>::to_dot(ostream_t& ss, P &&pt) const {
 	return true;
 }
 
-// collects all possible variations of the given item's rhs while respecting the
-// span of the item and stores them in the set ambset. 
+// the nonterminals of the items skipped by the Leo item of x in a set
+template <typename CharT>
+const vector<uint32_t>& earley<CharT>::skipped_nts(size_t set, size_t x) {
+	// go up the chain to its top or to a Leo item known already, then
+	// back down adding the nonterminal of each skipped item
+	vector<pair<leo_t*, uint32_t>> path;
+	leo_t* t;
+	auto intern = [this](const vector<uint32_t>& v) {
+		auto r = skipped_ids.emplace(v, skipped.size());
+		if (r.second) skipped.push_back(v);
+		return r.first->second;
+	};
+	for (;;) {
+		t = &L[set].at(x);
+		if (t->skipped != none) break;
+		const item& j = S[set][t->waiter];
+		if (j.prod == t->prod && j.from == t->from) {
+			t->skipped = intern({});
+			break;
+		}
+		x = get_nt(j).n(), set = j.from, path.emplace_back(t, x);
+	}
+	for (size_t k = path.size(); k--; ) {
+		vector<uint32_t> v = skipped[t->skipped];
+		auto it = lower_bound(v.begin(), v.end(), path[k].second);
+		if (it == v.end() || *it != path[k].second)
+			v.insert(it, path[k].second);
+		t = path[k].first, t->skipped = intern(v);
+	}
+	return skipped[t->skipped];
+}
+
 template <typename CharT>
-void earley<CharT>::sbl_chd_forest(const item &eitem,
-	std::vector<nidx_t> &curchd, size_t xfrom,
-	std::set<std::vector<nidx_t>> &ambset)
+std::pair<typename earley<CharT>::completions_t::const_iterator,
+	typename earley<CharT>::completions_t::const_iterator>
+	earley<CharT>::completions(size_t set, size_t x, size_t from)
 {
-	//check if we have reached the end of the rhs of prod
-	if (G[eitem.prod].size() <= curchd.size() + 1)  {
-		// match the end of the span we are searching in.
-		if (curchd.back().span.second == eitem.set)
-			ambset.insert(curchd);
-		return;
+	completions_t& c = C[set];
+	if (!C_built[set]) {
+		C_built[set] = true;
+		for (const item& i : S[set]) if (completed(i)) c.push_back(
+			{ (uint32_t) get_nt(i).n(), i.from, i.prod });
+		sort(c.begin(), c.end());
 	}
-	// curchd.size() refers to index of cur literal to process in the rhs of production
-	nidx_t nxtl = G[eitem.prod][curchd.size() + 1];
-	// set the span start/end of the terminal symbol 
-	if (!nxtl.nt()) {
-		nxtl.span.first = xfrom;
-		// for empty, use same span edge as from
-		if (nxtl.c() == (CharT) '\0') nxtl.span.second = xfrom;
-		// ensure well-formed combination (matching input) early
-		else if (xfrom < inputstr.size() &&
-					inputstr.at(xfrom) == nxtl.c())  
-			nxtl.span.second = ++xfrom ;
-		else // if not building the correction variation, prune this path quickly 
-			return;
-		// build from the next in the line
-		size_t lastpos = curchd.size();
-		curchd.push_back(nxtl),
-		sbl_chd_forest(eitem, curchd, xfrom, ambset);
-		curchd.erase(curchd.begin() + lastpos, curchd.end());
-	} else {
-		// get the from/to span of all non-terminals in the rhs of production.
-		nxtl.span.first = xfrom;
-		
-		//auto &nxtl_froms = sorted_citem[nxtl.n()][xfrom];
-		auto &nxtl_froms = sorted_citem[{nxtl.n(),xfrom}];
-		for (auto &v : nxtl_froms) {
-			// ignore beyond the span
-			if (v.set > eitem.set) continue;
-			// store current and recursively build for next nt
-			size_t lastpos = curchd.size(); 
-			nxtl.span.second = v.set,
-			curchd.push_back(nxtl), xfrom = v.set,
-			sbl_chd_forest(eitem, curchd, xfrom, ambset);
-			curchd.erase(curchd.begin() + lastpos, curchd.end());
+	// walk down the chains of the Leo items used skipping x, up to the
+	// topmost item, which is in the set
+	auto& u = leo_used[set];
+	const size_t n = c.size();
+	key_set met;
+	for (size_t k = 0; k < u.size(); ) {
+		const auto [y, j] = u[k];
+		if (const auto& v = skipped_nts(j, y); x != none &&
+			!binary_search(v.begin(), v.end(), x)) { ++k; continue; }
+		const leo_t& t = L[j].at(y);
+		for (size_t z = y, m = j; ; ) {
+			const item& i = S[m][L[m].at(z).waiter];
+			if ((i.prod == t.prod && i.from == t.from) ||
+				!met.insert((uint64_t(i.from) << 32) | i.prod)) break;
+			z = get_nt(i).n(), m = i.from;
+			c.push_back({ (uint32_t) z, i.from, i.prod });
+		}
+		u[k] = u.back(), u.pop_back();
+	}
+	if (c.size() != n) sort(c.begin(), c.end()),
+		c.erase(unique(c.begin(), c.end()), c.end());
+	if (x == none) return { c.begin(), c.end() };
+	const completion k{ (uint32_t) x, (uint32_t) from, 0 };
+	if (from == none) return equal_range(c.begin(), c.end(), k,
+		[](const completion& a, const completion& b) {
+			return a.nt < b.nt; });
+	return equal_range(c.begin(), c.end(), k,
+		[](const completion& a, const completion& b) {
+			return a.nt != b.nt ? a.nt < b.nt : a.from < b.from; });
+}
+
+// adds the uncompleted items of the sets up to the given one to occ
+template <typename CharT>
+void earley<CharT>::index_items(size_t set) {
+	for ( ; indexed <= set; ++indexed)
+		for (const item& i : S[indexed])
+			if (i.dot > 1 && !completed(i))
+				occ[{ i.from, dotted(i) }].push_back(indexed);
+}
+
+// labels the symbols and rhs prefixes of the productions added meanwhile
+template <typename CharT>
+void earley<CharT>::label_prods() {
+	for ( ; labeled != G.size(); ++labeled) {
+		const vector<lit>& p = G[labeled];
+		const size_t b = dotted(item(0, labeled, 0, 0));
+		sym_l.resize(b + p.size() + 1), pfx_l.resize(b + p.size() + 1);
+		for (size_t k = 0; k != p.size(); ++k) {
+			auto r = flit_ids.emplace(p[k], flits.size());
+			if (r.second) flits.push_back(p[k]);
+			sym_l[b + k] = r.first->second;
+		}
+		for (size_t k = 3; k < p.size(); ++k)
+			pfx_l[b + k] = pfx_bit | pfx_ids.emplace(vector<lit>(
+				p.begin() + 1, p.begin() + k), pfx_ids.size())
+				.first->second;
+	}
+}
+
+// the node of a label over a span, added unexpanded if new
+template <typename CharT>
+uint32_t earley<CharT>::fnode_id(size_t l, size_t from, size_t to,
+	size_t prod, size_t dot)
+{
+	if ((fn.size() + 1) * 4 > fid.size() * 3) {
+		// reparse may leave many nodes and no table
+		size_t z = std::max<size_t>(fid.size(), 512);
+		while ((fn.size() + 1) * 4 > z * 3) z *= 2;
+		fid.assign(z, none);
+		const size_t m = fid.size() - 1;
+		for (uint32_t n = 0; n != fn.size(); ++n) {
+			size_t k = hasher_t::combine(hasher_t::combine(
+				hasher_t::mix(fn[n].l), fn[n].from), fn[n].to) & m;
+			while (fid[k] != none) k = (k + 1) & m;
+			fid[k] = n;
 		}
 	}
+	const size_t m = fid.size() - 1;
+	size_t k = hasher_t::combine(hasher_t::combine(hasher_t::mix(l),
+		from), to) & m;
+	for ( ; fid[k] != none; k = (k + 1) & m)
+		if (const fnode& x = fn[fid[k]];
+			x.l == l && x.from == from && x.to == to) return fid[k];
+	fn.push_back({ (uint32_t) l, (uint32_t) from, (uint32_t) to,
+		(uint32_t) prod, (uint32_t) dot, 0, 0 });
+	return fid[k] = fn.size() - 1;
 }
+
+// adds the packs of the rhs prefix of prod before dot spanning from..to,
+// one for each place its last symbol may start at
+template <typename CharT>
+void earley<CharT>::add_packs(size_t prod, size_t dot, size_t from,
+	size_t to, vector<pair<uint32_t, uint32_t>>& ps)
+{
+	const size_t k = dr[prod] + dot - 1; // dotted rule before the symbol
+	const lit& l = G[prod][dot - 1];
+	auto pack = [&](size_t j) {
+		ps.emplace_back(dot == 2 ? none : dot == 3
+			? fnode_id(sym_l[k - 1], from, j)
+			: fnode_id(pfx_l[k], from, j, prod, dot - 1),
+			fnode_id(sym_l[k], j, to));
+	};
+	if (dot == 2 && !l.nt()) {
+		if (l.c() == (CharT) '\0') { if (from == to) pack(to); }
+		else if (to == from + 1 && inputstr[from] == l.c()) pack(from);
+		return;
+	}
+	// the sets where the item before the symbol is
+	auto it = occ.find({ from, k });
+	if (dot > 2 && it == occ.end()) return;
+	auto before = [&it](size_t j) {
+		return binary_search(it->second.begin(), it->second.end(),
+			(uint32_t) j);
+	};
+	if (!l.nt()) {
+		if (l.c() == (CharT) '\0') { if (before(to)) pack(to); }
+		else if (to > from && inputstr[to - 1] == l.c()
+			&& before(to - 1)) pack(to - 1);
+		return;
+	}
+	auto starts = [this, &l, to](size_t j) {
+		auto r = completions(to, l.n(), j);
+		return r.first != r.second;
+	};
+	if (dot == 2) { if (starts(from)) pack(from); return; }
+	// go through the fewer of the ends of the item before the symbol and
+	// the starts of the symbol
+	auto b = completions(to, l.n());
+	const vector<uint32_t>& a = it->second;
+	if (a.size() <= size_t(b.second - b.first)) {
+		for (uint32_t j : a)
+			if (j > to) break;
+			else if (starts(j)) pack(j);
+	} else for (auto e = b.first; e != b.second; ++e)
+		if ((e == b.first || e->from != (e - 1)->from) &&
+			e->from >= from && before(e->from)) pack(e->from);
+}
+
+// expands the nodes from first on, and the ones added meanwhile
+template <typename CharT>
+void earley<CharT>::build_forest(size_t first) {
+	vector<pair<uint32_t, uint32_t>> ps;
+	vector<uint32_t> prods;
+	for (size_t n = first; n < fn.size(); ++n) {
+		const fnode x = fn[n];
+		ps.clear();
+		if (x.l & pfx_bit) add_packs(x.prod, x.dot, x.from, x.to, ps);
+		else if (flits[x.l].nt()) {
+			auto r = completions(x.to, flits[x.l].n(), x.from);
+			prods.clear();
+			for (auto e = r.first; e != r.second; ++e)
+				prods.push_back(e->prod);
+			for (size_t p : prods)
+				add_packs(p, G[p].size(), x.from, x.to, ps);
+		} else continue;
+		sort(ps.begin(), ps.end());
+		ps.erase(unique(ps.begin(), ps.end()), ps.end());
+		fn[n].pack = fp.size(), fn[n].npacks = ps.size();
+		fp.insert(fp.end(), ps.begin(), ps.end());
+	}
+}
+
+template <typename CharT>
+typename earley<CharT>::nidx_t earley<CharT>::to_nidx(uint32_t id) {
+	const fnode& x = fn[id];
+	if (!(x.l & pfx_bit)) return nidx_t(flits[x.l], { x.from, x.to });
+	const size_t k = x.l & ~pfx_bit;
+	if (temps.size() <= k) temps.resize(k + 1, SIZE_MAX);
+	if (temps[k] == SIZE_MAX) {
+		stringstream ss;
+		put(ss << "temp", k);
+		temps[k] = d.get(ss.str());
+	}
+	return nidx_t(lit{ temps[k] }, { x.from, x.to });
+}
+
+// adds to packs the children sequences made of a sequence of left, if any,
+// followed by seq, which is reversed
+template <typename CharT>
+void earley<CharT>::unbinarize(uint32_t left, vector<nidx_t>& seq,
+	set<vector<nidx_t>>& packs)
+{
+	if (left != none && (fn[left].l & pfx_bit)) {
+		const fnode& x = fn[left];
+		for (size_t k = x.pack; k != x.pack + x.npacks; ++k)
+			seq.push_back(to_nidx(fp[k].second)),
+			unbinarize(fp[k].first, seq, packs), seq.pop_back();
+		return;
+	}
+	if (left != none) seq.push_back(to_nidx(left));
+	packs.emplace(seq.rbegin(), seq.rend());
+	if (left != none) seq.pop_back();
+}
+
+// fills pfgraph from the built nodes, or from the ones under root unless
+// none, having the rhs prefixes nodes as temporary nonterminals when
+// binarized, or else spread into the packs
 template <typename CharT>
-void earley<CharT>::pre_process(const item &i){
-
-	//sorted_citem[G[i.prod][0].n()][i.from].emplace_back(i);
-	if (completed(i))
-		sorted_citem[{ G[i.prod][0].n(), i.from }].emplace_back(i),
-		rsorted_citem[{ G[i.prod][0].n(), i.set }].emplace_back(i);
-	else if (bin_lr) {
-		// Precreating temporaries to help in binarisation later
-		// each temporary represents a partial rhs production with
-		// atleast 3 symbols
-		if (i.dot >= 3) {
-			std::vector<lit> v(G[i.prod].begin() + 1,
-						G[i.prod].begin() + i.dot);
-			lit tlit;
-			if (bin_tnt.find(v) == bin_tnt.end()) {
-				stringstream ss;
-				put(ss << "temp", tid++);
-				tlit = lit{ d.get(ss.str()) };
-				bin_tnt.insert({ v, tlit });
+void earley<CharT>::to_pfgraph(uint32_t root) {
+	vector<bool> under(fn.size(), root == none);
+	vector<uint32_t> todo;
+	if (root != none) under[root] = true, todo.push_back(root);
+	while (!todo.empty()) {
+		const fnode& x = fn[todo.back()];
+		todo.pop_back();
+		for (size_t k = x.pack; k != x.pack + x.npacks; ++k)
+			for (uint32_t c : { fp[k].first, fp[k].second })
+				if (c != none && !under[c])
+					under[c] = true, todo.push_back(c);
+	}
+	vector<nidx_t> seq;
+	for (uint32_t n = 0; n != fn.size(); ++n) {
+		const fnode& x = fn[n];
+		if (!under[n] || ((x.l & pfx_bit) ? !bin_lr : !flits[x.l].nt()))
+			continue;
+		auto& packs = pfgraph[to_nidx(n)];
+		for (size_t k = x.pack; k != x.pack + x.npacks; ++k) {
+			const auto& [l, r] = fp[k];
+			if (!bin_lr) {
+				seq = { to_nidx(r) }, unbinarize(l, seq, packs);
+				continue;
 			}
-			else tlit = bin_tnt[v];
-			
-			//DBG(print(o::dbg(), i);)
-			//o::dbg()<< endl << d.get(tlit.n()) << v << endl;
-			sorted_citem[{ tlit.n(), i.from }].emplace_back(i),
-			rsorted_citem[{ tlit.n(), i.set }].emplace_back(i);
+			vector<nidx_t> v;
+			if (l != none) v.push_back(to_nidx(l));
+			v.push_back(to_nidx(r)), packs.insert(v);
 		}
 	}
 }
+
 template <typename CharT>
 bool earley<CharT>::forest() {
-	bool ret = false;
-	// clear forest structure if any
+	// nodes kept by reparse, which may be out of the new forest
+	const size_t first = fn.size();
 	pfgraph.clear();
-	bin_tnt.clear();
-	tid = 0;
 	// set the start root node
 	size_t len = inputstr.length();
-	nidx_t root(start, {0,len});
-	// preprocess earley items for faster retrieval
+	// index earley items for faster retrieval
 	emeasure_time_start(tspfo, tepfo);
-	int count = 0;
-
-	for(size_t n=0; n<len+1 ; n++)
-		for (const item& i : S[n]) {
-			count++;
-			pre_process(i);
-		}
-
+	label_prods(), index_items(len);
+	size_t count = 0;
+	for (const auto& s : S) count += s.size();
 	emeasure_time_end(tspfo, tepfo) << " :: preprocess time ," <<
 						"size : "<< count << "\n";
-	o::inf() <<"sort sizes : " << sorted_citem.size() << " " <<
-						rsorted_citem.size() <<" \n";
 	// build forest
 	emeasure_time_start(tsf, tef);
-	ret = bin_lr ? build_forest2(root) : build_forest(root);
+	auto r = completions(len, start.n(), 0);
+	bool ret = r.first != r.second;
+	if (ret) {
+		const uint32_t root = fnode_id(flit_ids.at(start), 0, len);
+		build_forest(first), to_pfgraph(first ? root : none);
+	}
 	emeasure_time_end(tsf, tef) <<" :: forest time "<<endl ;
+	o::inf() <<"forest sizes : " << fn.size() << " " << fp.size() << " \n";
 
 	o::pms() <<"# parse trees " << count_parsed_trees() <<endl;
 	// emit output in various formats
@@ -845,128 +1143,6 @@ bool earley<CharT>::forest() {
 
 	return ret; 
 }
-template <typename CharT>
-bool earley<CharT>::bin_lr_comb(const item& eitem,
-	std::set<std::vector<nidx_t>>& ambset)
-{
-	std::vector<nidx_t> rcomb, lcomb;
-	if (eitem.dot < 2) return false;
-
-	nidx_t right = G[eitem.prod][eitem.dot-1];
-
-	if (!right.nt()) {
-		right.span.second = eitem.set;
-		if (right.c() == (CharT) '\0')
-			right.span.first = right.span.second;
-		else if (inputstr.at(eitem.set -1) == right.c() )
-			right.span.first = eitem.set -1 ;
-		else return false;
-		rcomb.emplace_back(right);
-	} else {
-		auto &rightit = rsorted_citem[{right.n(), eitem.set}];
-		for (auto &it : rightit)
-			if (eitem.from <= it.from) 
-				right.span.second = it.set,
-				right.span.first = it.from,
-				rcomb.emplace_back(right);
-	}
-	// many literals in rhs
-	if (eitem.dot > 3) {
-		//DBG(print(o::dbg(), eitem);)
-		std::vector<lit> v(G[eitem.prod].begin() + 1,
-					G[eitem.prod].begin() + eitem.dot - 1);
-		DBG(assert( bin_tnt.find(v) != bin_tnt.end());)
-		nidx_t left = bin_tnt[v];
-		//DBG(COUT << std::endl << d.get(bin_tnt[v].n()) << std::endl);
-		auto &leftit = sorted_citem[{left.n(), eitem.from}];
-		// doing left right optimization
-		for (auto &it : leftit) 
-			for (auto &rit : rcomb)    
-				if (it.set == rit.span.first) {
-					left.span.first = it.from;
-					left.span.second = it.set;
-					ambset.insert({left, rit});
-				} 
-	}
-	// exact two literals in rhs
-	else if (eitem.dot == 3) {
-		nidx_t left = G[eitem.prod][eitem.dot-2];
-		if (!left.nt()) {
-			left.span.first = eitem.from;
-			if (left.c() == (CharT) '\0')
-				left.span.second = left.span.first;
-			else if (inputstr.at(eitem.from) == left.c() )
-				left.span.second = eitem.from + 1  ;
-			else return false;
-			//do Left right optimisation
-			for (auto &rit : rcomb)  
-				if (left.span.second == rit.span.first)
-					ambset.insert({ left, rit });
-		}
-		else {
-			auto &leftit = sorted_citem[{left.n(), eitem.from}];
-			for (auto &it : leftit) 
-				for (auto &rit : rcomb)    
-					if (it.set == rit.span.first)
-						left.span.first = it.from,
-						left.span.second = it.set,
-						ambset.insert({ left, rit });
-		}
-	}
-	else {
-		DBG(assert(eitem.dot == 2));
-		for (auto &rit : rcomb)
-			if (eitem.from <= rit.span.first)
-				ambset.insert({ rit });
-	}
-	return true;
-}
-
-// builds the forest starting with root
-template <typename CharT>
-bool earley<CharT>::build_forest ( const nidx_t &root ) {
-	if (!root.nt()) return false;
-	if (pfgraph.find(root) != pfgraph.end()) return false;
-
-	//auto &nxtset = sorted_citem[root.n()][root.span.first];
-	auto &nxtset = sorted_citem[{root.n(),root.span.first}];
-	std::set<std::vector<nidx_t>> ambset;
-	for (const item &cur : nxtset) {
-		if (cur.set != root.span.second) continue;
-		assert(root.n() == G[cur.prod][0].n() );
-		nidx_t cnode( G[cur.prod][0], {cur.from, cur.set} );
-		vector<nidx_t> nxtlits;
-		sbl_chd_forest(cur, nxtlits, cur.from, ambset );
-		pfgraph[cnode] = ambset;
-		for (auto &aset : ambset)
-			for (const nidx_t& nxt : aset) {
-				build_forest(nxt);
-			}
-	}	
-	return true;
-}
-
-template <typename CharT>
-bool earley<CharT>::build_forest2 (const nidx_t &root) {
-	if (!root.nt()) return false;
-	if (pfgraph.find(root) != pfgraph.end()) return false;
-
-	//auto &nxtset = sorted_citem[root.n()][root.span.first];
-	auto &nxtset = sorted_citem[{ root.n(),root.span.first }];
-	std::set<std::vector<nidx_t>> ambset;
-	for (const item &cur: nxtset) {
-		if (cur.set != root.span.second) continue;
-		nidx_t cnode(completed(cur) ? G[cur.prod][0] : lit{ root.n() },
-			{ cur.from, cur.set } );
-		bin_lr_comb(cur, ambset);
-		pfgraph[cnode] = ambset;
-		for (auto &aset: ambset )
-			for (const nidx_t& nxt : aset) {
-				build_forest2(nxt);
-			}
-	}
-	return true;
-}
 
 template <typename CharT>
 vector<typename earley<CharT>::node_children> earley<CharT>::get_children(
@@ -98,7 +98,7 @@ private:
 	struct item {
 		item(size_t set, size_t prod, size_t from, size_t dot) :
 			set(set), prod(prod), from(from), dot(dot) {}
-		size_t set, prod, from, dot;
+		uint32_t set, prod, from, dot;
 		// mutable std::set<item> advancers, completers;
 		bool operator<(const item& i) const {
 			if (set != i.set) return set < i.set;
@@ -166,6 +166,10 @@ public:
 			earley(g, {}, _bin_lr, _incr_gen_forest) {}
 
 	bool recognize(const string s);
+	// recognizes s keeping the chart, so that the next reparse of an
+	// input sharing a prefix with s redoes it from where they differ only
+	bool reparse(const string s);
+	bool append(const string& s) { return reparse(inputstr + s); }
 	std::vector<arg_t> get_parse_graph_facts();
 	string flatten(string label, const nidx_t nd) const;
 	uintmax_t count_parsed_trees() ;
@@ -197,7 +201,7 @@ private:
 	string epsilon() const;
 	node_children_variations get_children(const nidx_t nd, bool all = false)
 		const;
-	bool bin_lr;  //enables binarizaion and left right optimization
+	bool bin_lr;  //keeps the parse forest binarized
 	bool incr_gen_forest; //enables incremental generation of forest
 	ostream& put(ostream& os, const size_t& n) const {
 		for (const auto& ch : to_string_(n)) os.put((CharT) ch);
@@ -215,52 +219,34 @@ private:
 	std::string to_stdstr(const string& s) const;
 	std::string to_stdstr(const char32_t& s) const;
 	struct hasher_t{
-		size_t hash_size_t(const size_t &val) const{
-			return std::hash<size_t>()(val) + 0x9e3779b9 +
-							(val << 6) + (val >> 2);
+		// splitmix64's finalizer, so that nearby values spread apart
+		static size_t mix(uint64_t x) {
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+			return x ^ (x >> 31);
+		}
+		// order dependent, unlike xor, so (a, b) and (b, a) differ
+		static size_t combine(size_t h, size_t v) {
+			return h ^ (mix(v) + 0x9e3779b97f4a7c15ull + (h << 6)
+				+ (h >> 2));
 		}
 		size_t operator()(const std::pair<size_t, size_t> &k) const {
-			// lets substitute with better if possible.
-			std::size_t h = 0;
-			h ^= hash_size_t(k.first); 
-			h ^= hash_size_t(k.second);
-			return h;
+			return combine(mix(k.first), k.second);
 		}
 		size_t operator()(const nidx_t &k) const {
-			// lets substitute with better if possible.
-			std::size_t h = 0;
-			h ^= hash_size_t(k.span.first); 
-			h ^= hash_size_t(k.span.second);
-			h ^= hash_size_t(size_t(k.l.nt()?k.l.n():k.c()));
-			return h;
-		}
-		size_t operator()(const item &k) const {
-			// lets substitute with better if possible.
-			std::size_t h = 0;
-			h ^= hash_size_t(k.set);
-			h ^= hash_size_t(k.from);
-			h ^= hash_size_t(k.prod);
-			h ^= hash_size_t(k.dot);
-			return h;
+			return combine(combine(mix(k.span.first), k.span.second),
+				size_t(k.l.nt() ? k.l.n() : k.c()));
 		}
 	};
-	//std::unordered_map< size_t, 
-	//	std::unordered_map<size_t, std::vector<item>>>  sorted_citem;
-	std::unordered_map<std::pair<size_t, size_t>, std::vector<item>,
-		hasher_t> sorted_citem, rsorted_citem;
 	parse_forest_t pfgraph;
-	std::map<std::vector<earley::lit>, earley::lit> bin_tnt; // binariesed temporary intermediate non-terminals
-	size_t tid; // id for temporary non-terminals
 	std::vector<char_builtin_t> builtins;
 	std::vector<std::map<CharT, size_t>> builtin_char_prod; // char -> prod
 	std::string grammar_text() const;
-	bool build_forest ( const nidx_t &root );
-	bool build_forest2 ( const nidx_t &root );
-	void pre_process(const item &i);
 	bool forest();
-	bool bin_lr_comb(const item&, std::set<std::vector<nidx_t>>&);
-	void sbl_chd_forest(const item&, std::vector<nidx_t>&, size_t,
-		std::set<std::vector<nidx_t>>&);
+	// whether the chart of the last input, W included, is kept
+	bool chart = false;
+	bool parse(const string& s, size_t from, bool keep);
+	void truncate(size_t p);
 	template <typename T, typename P = ptree_t>
 	bool iterate_forest(T, P &&pt = ptree_t()) const;
 	//bool visit_forest(std::function<void(std::string, size_t, std::vector<std::variant<size_t, std::string>>)> out_rel) const;
@@ -275,12 +261,132 @@ private:
 	std::string to_tml_rule(const nidx_t nd) const;
 	template <typename CharU>
 	friend int test_out(int c, earley<CharU> &e);
-	typedef std::unordered_set<earley<CharT>::item, earley<CharT>::hasher_t> container_t;
-	typedef container_t::iterator container_iter;
-	std::vector<container_t> S;
-	container_iter add(container_t& t, const item& i);
-	void complete(const item& i, container_t& t);
-	void predict(const item& i, container_t& t);
+	// Open addressing set of 64 bit keys other than ~0
+	struct key_set {
+		std::vector<uint64_t> t;
+		size_t n = 0;
+		bool insert(uint64_t k) {
+			if ((n + 1) * 4 > t.size() * 3) {
+				std::vector<uint64_t> o(std::max<size_t>(
+					t.size() * 2, 64), ~uint64_t(0));
+				o.swap(t), n = 0;
+				for (uint64_t x : o) if (~x) insert(x);
+			}
+			const size_t m = t.size() - 1;
+			for (size_t i = hasher_t::mix(k) & m; ; i = (i + 1) & m)
+				if (t[i] == k) return false;
+				else if (!~t[i]) return t[i] = k, ++n, true;
+		}
+		void clear() {
+			if (n) std::fill(t.begin(), t.end(), ~uint64_t(0)), n = 0;
+		}
+	};
+	// The Earley sets, each in the order its items were added
+	std::vector<std::vector<item>> S;
+	// Per set, the indices of the items expecting each nonterminal
+	std::vector<std::unordered_map<size_t, std::vector<uint32_t>>> W;
+	// Offset of the first dotted rule of each production, so that a
+	// production and a dot number a dotted rule
+	std::vector<uint32_t> dr;
+	// Items already in the set being processed and in the next one. Items
+	// starting at the set being processed are told by their dotted rule
+	// only, the others by their start and dotted rule.
+	std::vector<bool> here;
+	key_set seen[2];
+	// Productions of each nonterminal, and the last set predicting it
+	std::vector<std::vector<size_t>> nt_prods;
+	std::vector<size_t> predicted;
+	// The set being processed and the nonterminals completed in it with
+	// an empty span
+	size_t cur = 0;
+	std::set<size_t> empty_done;
+	size_t dotted(const item& i) {
+		while (dr.size() <= i.prod) dr.push_back(dr.back() +
+			G[dr.size() - 1].size() + 1);
+		return dr[i.prod] + i.dot;
+	}
+	bool push(const item& i);
+	void add(const item& i);
+	void complete(const item& i);
+	void predict(const item& i);
+	// Leo's items: the only item of a set waiting for a nonterminal, when
+	// its completion completes it, and the topmost item of the chain of
+	// such completions. Completing the nonterminal adds that topmost item
+	// only, so right recursion takes linear time and space.
+	static constexpr uint32_t none = UINT32_MAX;
+	struct leo_t { uint32_t waiter, prod, from, skipped = none; };
+	std::vector<std::unordered_map<size_t, leo_t>> L;
+	// Per set, the nonterminals and starts of the completions shortcut by
+	// a Leo item, whose skipped items are recovered for the forest when
+	// asked for
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> leo_used;
+	const leo_t& leo(size_t set, size_t x);
+	// the sorted nonterminals of the items a Leo item skips, interned
+	std::vector<std::vector<uint32_t>> skipped;
+	std::map<std::vector<uint32_t>, uint32_t> skipped_ids;
+	const std::vector<uint32_t>& skipped_nts(size_t set, size_t x);
+	// The items completed in a set, as nonterminal, start and production
+	// sorted, once the set is done. Items skipped by Leo items are added
+	// as their nonterminals are asked for.
+	struct completion {
+		uint32_t nt, from, prod;
+		bool operator<(const completion& c) const {
+			if (nt != c.nt) return nt < c.nt;
+			if (from != c.from) return from < c.from;
+			return prod < c.prod;
+		}
+		bool operator==(const completion& c) const {
+			return nt == c.nt && from == c.from && prod == c.prod;
+		}
+	};
+	typedef std::vector<completion> completions_t;
+	std::vector<completions_t> C;
+	std::vector<bool> C_built;
+	// the completions of x, or of all nonterminals if none, in a set,
+	// starting at from unless none. Valid until asking for another x.
+	std::pair<typename completions_t::const_iterator,
+		typename completions_t::const_iterator> completions(size_t set,
+		size_t x, size_t from = none);
+	// Sets holding each uncompleted item by its start and dotted rule
+	std::unordered_map<std::pair<size_t, size_t>, std::vector<uint32_t>,
+		hasher_t> occ;
+	size_t indexed = 0;
+	void index_items(size_t set);
+
+	// The binarized shared packed parse forest. A node is labeled by a
+	// symbol or by a rhs prefix of at least two symbols, and spans the
+	// input from..to. Each of its packs is the node of the rhs prefix but
+	// its last symbol, if more than one symbol remains, or else that
+	// symbol's node, or none, and the node of the last symbol. Prefix
+	// labels have the top bit set and keep a production and dot having
+	// the prefix, nodes are numbered by their place in fn.
+	static constexpr uint32_t pfx_bit = 1u << 31;
+	struct fnode {
+		uint32_t l, from, to, prod, dot, pack, npacks;
+	};
+	std::vector<fnode> fn;
+	std::vector<std::pair<uint32_t, uint32_t>> fp;
+	// open addressing table of the nodes, by label and span
+	std::vector<uint32_t> fid;
+	// Labels of the symbol at and of the rhs prefix before each dotted
+	// rule, and the symbols and prefixes they stand for
+	std::vector<uint32_t> sym_l, pfx_l;
+	std::vector<lit> flits;
+	std::map<lit, uint32_t> flit_ids;
+	std::map<std::vector<lit>, uint32_t> pfx_ids;
+	size_t labeled = 0;
+	// temporary nonterminals naming prefixes in the binarized parse forest
+	std::vector<size_t> temps;
+	void label_prods();
+	uint32_t fnode_id(size_t l, size_t from, size_t to, size_t prod = 0,
+		size_t dot = 0);
+	void add_packs(size_t prod, size_t dot, size_t from, size_t to,
+		std::vector<std::pair<uint32_t, uint32_t>>& ps);
+	void build_forest(size_t first);
+	nidx_t to_nidx(uint32_t id);
+	void unbinarize(uint32_t left, std::vector<nidx_t>& seq,
+		std::set<std::vector<nidx_t>>& packs);
+	void to_pfgraph(uint32_t root = none);
 
 
 	struct overlay_tree {
@@ -16,6 +16,7 @@
 #include <tuple>
 #include <vector>
 #include "defs.h"
+#include "bdd.h"
 
 typedef std::shared_ptr<struct pnft> pnft_handle;
 typedef const pnft_handle& cr_pnft_handle;
@@ -15,6 +15,9 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#ifdef WITH_THREADS
+#include <thread>
+#endif
 #include "input.h"
 #include "err.h"
 #include "output.h"
@@ -48,19 +51,19 @@ input::~input() {
 	if (allocated_) free((void*)beg_);
 }
 
-lexeme input::lex(pccs s) {
-#define PE(pe) ((pe), lexeme{ 0, 0 })
+lexeme input::lex(pccs s, bool* fail) {
+#define PE(pe) ((fail ? (*fail = true) : (pe)), lexeme{ 0, 0 })
 	while (isspace(**s)) ++*s;
 	if (!**s) return { 0, 0 };
 	ccs t = *s;
 	if (!strncmp(*s, "/*", 2)) {
 		while (strncmp(++*s, "*/", 2))
 			if (!**s) return PE(parse_error(t, err_comment, 0));
-		return ++++*s, lex(s);
+		return ++++*s, lex(s, fail);
 	}
 	if (**s == '#') {
 		while (*++*s != '\r' && **s != '\n' && **s);
-		return lex(s);
+		return lex(s, fail);
 	}
 	if (**s == '"') {
 		while (*++*s != '"')
@@ -125,11 +128,84 @@ lexeme input::lex(pccs s) {
 #undef PE
 }
 
+#ifdef WITH_THREADS
+/* Splits the data into chunks of at least lex_chunk bytes, at most one per
+ * thread, starting right after a statement. Lexes them in parallel and
+ * appends their lexemes to l. A chunk starts at the first non space
+ * character of a line following a line that ends with a '.'. Such a position
+ * may still be inside a comment or a string, so a chunk is used only when
+ * lexing from the start reaches exactly its first character. That holds when
+ * the preceding chunk ends there, otherwise the gap is lexed sequentially. On
+ * a lexing error in a chunk data_ is left at its start, for prog_lex to
+ * report the error. */
+
+void input::prog_lex_parallel() {
+	const size_t nthreads = std::min<size_t>(lex_threads ? lex_threads
+		: thread::hardware_concurrency(), size_ / max<size_t>(lex_chunk, 1));
+	if (nthreads < 2) return;
+	ccs end = beg_ + size_;
+	vector<ccs> b = { data_ };
+	for (size_t n = 1; n != nthreads; ++n) {
+		ccs p = max(b.back(), beg_ + size_ / nthreads * n), q;
+		while ((q = (ccs)memchr(p, '\n', end - p))) {
+			p = q + 1;
+			while (q > beg_ && isspace(*(q - 1))) --q;
+			if (q > beg_ && *(q - 1) == '.') break;
+		}
+		if (!q) break;
+		while (p < end && isspace(*p)) ++p;
+		if (p == end) break;
+		b.push_back(p);
+	}
+	b.push_back(end);
+	const size_t n = b.size() - 1;
+	vector<lexemes> ls(n);
+	vector<ccs> ends(n);
+	vector<char> fails(n, false);
+	auto lex_chunk = [this, &b, &ls, &ends, &fails, n](size_t i) {
+		ccs s = b[i];
+		bool fail = false;
+		for (lexeme e;;) {
+			while (isspace(*s)) ++s;
+			if (s >= b[i + 1] || !*s) break;
+			if ((e = lex(&s, &fail)) != lexeme{ 0, 0 }) ls[i].push_back(e);
+			else if (fail || !*s) break;
+		}
+		// the last chunk lexes up to the terminating null
+		if (i == n - 1 && s == b[i + 1] && *s) fail = true;
+		ends[i] = s, fails[i] = fail;
+	};
+	vector<thread> ts;
+	for (size_t i = 1; i != n; ++i) ts.emplace_back(lex_chunk, i);
+	lex_chunk(0);
+	for (thread& t : ts) t.join();
+	size_t sz = l.size();
+	for (const lexemes& x : ls) sz += x.size();
+	l.reserve(sz);
+	for (size_t i = 0; i != n; ++i) {
+		// lex sequentially up to the chunk when its preceding split is not
+		// valid, the chunk is used if the lexer reaches exactly its start
+		for (lexeme e; !error;) {
+			while (isspace(*data_)) ++data_;
+			if (data_ >= b[i] || !*data_) break;
+			if ((e = lex(&data_)) != lexeme{ 0, 0 }) l.push_back(e);
+		}
+		if (error || data_ != b[i]) continue;
+		if (fails[i]) return;
+		l.insert(l.end(), ls[i].begin(), ls[i].end()), data_ = ends[i];
+	}
+}
+#endif
+
 lexemes& input::prog_lex() {
 	lexeme e;
 	error = false;
-	do { if ((e=lex(&data_)) != lexeme{0,0}) l.push_back(e);
-	} while (!error && *(data_));
+#ifdef WITH_THREADS
+	prog_lex_parallel();
+#endif
+	if (!error && *data_)
+		do { if ((e=lex(&data_)) != lexeme{0,0}) l.push_back(e);
+		} while (!error && *(data_));
 	size_ = (data_ - beg_) * sizeof(ccs);
 	return l;
 }
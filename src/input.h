@@ -41,6 +41,8 @@ struct input {
 	size_t pos = 0;      // position of the currently parsed lexeme
 	lexemes l = {};      // lexemes scanned from the input data
 	bool error = false;  // parse error in the input's data
+	size_t lex_chunk = 1 << 20; // min. bytes per thread for parallel lexing
+	size_t lex_threads = 0;     // max. lexing threads, 0 for hw concurrency
 	/**
 	 * STDIN input constructor
 	 * @param ns - if true this input would be added as a new sequence ({})
@@ -81,11 +83,12 @@ struct input {
 	/**
 	 * lex scans a lexeme in a data pointer s and iterates it
 	 * @param s - pointer to the input data
+	 * @param fail - if set, errors are flagged in it instead of reported
 	 * @return scanned lexeme
 	 */
-	lexeme lex(pccs s);
+	lexeme lex(pccs s, bool* fail = 0);
 	/**
-	 * scans input's data for lexemes
+	 * scans input's data for lexemes, in parallel for large inputs
 	 * @return scanned lexemes
 	 */
 	lexemes& prog_lex();
@@ -153,6 +156,9 @@ private:
 	bool allocated_ = false;
 	int fd_ = -1;
 	std::unique_ptr<input> next_ = 0;
+#ifdef WITH_THREADS
+	void prog_lex_parallel();
+#endif
 	size_t load_stdin() {
 		ostringstream_t ss; ss << CIN.rdbuf();
 		beg_ = (ccs) strdup((ws2s(ss.str())).c_str()),
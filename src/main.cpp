@@ -31,6 +31,9 @@ int main(int argc, char** argv) {
 	bdd::init(o.enabled("bdd-mmap") ? MMAP_WRITE : MMAP_NONE,
 		o.get_int("bdd-max-size"), o.get_string("bdd-file"));
 	bdd::set_gc_enabled(o.get_bool("gc"));
+#ifdef WITH_THREADS
+	bdd::set_threads(max<int_t>(o.get_int("bdd-threads"), 1));
+#endif
 	// read from stdin by default if no -i(e), -h, -v and no -repl/udp
 	if (o.disabled("i") && o.disabled("ie")
 #ifdef WITH_THREADS
@@ -50,6 +53,9 @@ int main(int argc, char** argv) {
 		if (o.enabled("dump") && d.result) d.out_result();
 		if (o.enabled("dict")) d.out_dict(o::inf());
 		if (o.enabled("csv")) d.save_csv();
+		if (o.get_string("bin").size()) d.save_bin(o.get_string("bin"));
+		if (o.get_string("save-dict").size())
+			d.save_dict(o.get_string("save-dict"));
 #ifdef WITH_THREADS
 	}
 #endif
@@ -15,6 +15,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <exception>
+#include <map>
+#include <memory>
 #ifdef _WIN32
 #include <windows.h>
 #else
@@ -240,41 +242,48 @@ private:
 	}
 };
 
+/* Allocates every block in a memory map of its own, which is kept open until
+ * the block is deallocated. A growing vector thus keeps reading its old block
+ * while copying it into the new, larger one. Blocks of a named file map the
+ * same file, which is extended to the size of the larger block. Copies of an
+ * allocator share their maps so that any of them can deallocate a block. */
 template <typename T>
 class memory_map_allocator {
+	typedef std::map<T*, std::unique_ptr<memory_map>> maps;
 public:
 	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
 	memory_map_allocator() : fn(""), m(MMAP_NONE) { }
 	memory_map_allocator(std::string fn, mmap_mode m = MMAP_WRITE) :
-		fn(fn), m(m) { }
-	memory_map_allocator(const memory_map_allocator<T>& a) :
-		fn(a.fn), m(a.m) { }
+		fn(fn), m(m), mms(std::make_shared<maps>()) { }
 	T* allocate(size_t n) {
 		//DBG(o::dbg()<<"allocate n="<<n<<" fn="
 		//	<<s2ws(fn)<<" m="<<m<<std::endl;)
 		if (m == MMAP_NONE) return (T*) nommap.allocate(n);
 		if (n == 0) return 0;
-		mm = std::make_unique<memory_map>(fn, n*sizeof(T), m);
+		auto mm = std::make_unique<memory_map>(fn, n*sizeof(T), m);
 		//o::dbg() << "mm.data() = " << mm->data() << std::endl;
-		return (T*) mm->data();
+		T* p = (T*) mm->data();
+		if (!p) throw std::bad_alloc();
+		return mms->emplace(p, std::move(mm)), p;
 	}
 	void deallocate(T* p, size_t n) {
 		//DBG(o::dbg()<<"deallocate n="<<n<<
 		//	" fn="<<s2ws(std::string(fn))<<" m="<<m<<std::endl;)
 		if (m == MMAP_NONE) return (void) nommap.deallocate(p, n);
 		if (!p || !n) return;
-		mm->close();
+		mms->erase(p);
 	}
-	bool operator==(const memory_map_allocator& t) const {                
-		return fn == t.fn && m == t.m && mm == t.mm && nommap==t.nommap;
+	bool operator==(const memory_map_allocator& t) const {
+		return fn == t.fn && m == t.m && mms == t.mms;
 	}
 	bool operator!=(const memory_map_allocator& t) const {
-		return fn != t.fn || m != t.m || mm != t.mm || nommap!=t.nommap;
+		return !(*this == t);
 	}
 private:
 	std::string fn;
 	mmap_mode m;
-	std::unique_ptr<memory_map> mm;
+	std::shared_ptr<maps> mms;
 	std::allocator<T> nommap;
 };
 
@@ -202,18 +202,32 @@ void options::setup() {
 		" the program into one where each step is equivalent to 2^x of"
 		" the original's (default: x=0)"));
 	add_bool("gc",      "enable garbage collection");
+	add_bool("semi-naive", "evaluate programs without deletions semi-naively");
 	add(option(option::type::ENUM, { "proof" }, { "none", "tree", "forest", 
 		"partial-tree", "partial-forest" }).description("control if and"
 		" how proofs are extracted: none (default), tree, forest,"
 		" partial-tree, partial-forest"));
 	add_bool("run",     "run program     (enabled by default)");
 	add_bool("csv",     "save result into CSV files");
+	add(option(option::type::STRING, { "bin" }).description("save result"
+		" into a binary columnar file"));
+	add(option(option::type::STRING, { "load" }).description("load facts"
+		" from tab separated or binary columnar files (comma separated)"));
+	add(option(option::type::STRING, { "load-dict" }).description("load"
+		" symbols saved by -save-dict before reading the program"));
+	add(option(option::type::STRING, { "save-dict" }).description("save"
+		" symbols into a file"));
 
 	add_bool("bdd-mmap","use memory mapping for BDD database");
 	add(option(option::type::INT, { "bdd-max-size" }).description(
-		"Maximum size of a bdd memory map (default: 128 MB)"));
+		"Initial size of a bdd memory map, grown as needed"
+		" (default: 128 MB)"));
 	add(option(option::type::STRING, { "bdd-file" })
 		.description("Memory map file used for BDD database"));
+#ifdef WITH_THREADS
+	add(option(option::type::INT, { "bdd-threads" }).description(
+		"Threads conjoining large BDDs (default: 1)"));
+#endif
 
 	add(option(option::type::INT, { "steps", "s" })
 		.description("run N steps"));
@@ -271,8 +285,8 @@ void options::setup() {
 	add_bool2("earley", "ep", "use earley parser");
 	add_bool2("print-ambiguity", "pamb", "print parsed ambiguous packs");
 	add_bool2("print-traversing", "ptrv", "print parsed nodes traversed");
-	add_bool2("bin-lr", "blr", "on the fly binarization and left "
-					"right optimization for earley items");
+	add_bool2("bin-lr", "blr", "keep the parse forest binarized, rhs "
+					"prefixes as temporary nonterminals");
 	add_bool2("incr-gen-forest", "igf", "incremental generation of forest");
 	add_output    ("dump",        "dump output     (@stdout by default)");
 	add_output_alt("output", "o","standard output (@stdout by default)");
@@ -317,6 +331,7 @@ void options::init_defaults() {
 	error |= !parse(strings{
 		"--run",
 		"--gc",
+		"--semi-naive",
 		"--proof",       "none",
 		"--output",      "@stdout",
 		"--dump",        "@stdout",
@@ -329,6 +344,7 @@ void options::init_defaults() {
 		"--bdd-max-size","134217728", // 128 MB
 		"--safecheck",
 #ifdef WITH_THREADS
+		"--bdd-threads", "1",
 		"--repl-output", "@stdout",
 		"--udp-addr",    "127.0.0.1",
 		"--udp-port",    "6283"
@@ -844,6 +844,11 @@ basic_ostream<T>& operator<<(basic_ostream<T>& os, const dict_t& d) {
 template basic_ostream<char>& operator<<(basic_ostream<char>&, const dict_t&);
 template basic_ostream<wchar_t>& operator<<(basic_ostream<wchar_t>&, const dict_t&);
 
+template <typename T>
+basic_ostream<T>& operator<<(basic_ostream<T>& os, const bdd_handle& h) {
+	return os << h->b;
+}
+
 template <typename T, typename VT>
 basic_ostream<T>& operator<<(basic_ostream<T>& os, const std::vector<VT>& hs) {
 	os << "[ ";
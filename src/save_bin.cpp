@@ -0,0 +1,56 @@
+// LICENSE
+// This software is free for use and redistribution while including this
+// license notice, unless:
+// 1. is used for commercial or non-personal purposes, or
+// 2. used for a product which includes or associated with a blockchain or other
+// decentralized database technology, or
+// 3. used for a product which includes or associated with the issuance or use
+// of cryptographic or electronic currencies/coins/tokens.
+// On all of the mentioned cases, an explicit and written permission is required
+// from the Author (Ohad Asor).
+// Contact ohad@idni.org for requesting a permission. This license may be
+// modified over time by the Author.
+#include <fstream>
+#include "driver.h"
+using namespace std;
+
+/* Save the result as a stream of 32 bit integers in host byte order:
+ *
+ *   "TMLC" version
+ *   nsyms, then per symbol: length, bytes
+ *   per table: name length, name bytes, arity, then chunks of
+ *     n, followed by arity columns of n values each,
+ *   ended by a chunk with n = 0.
+ *
+ * Values are as stored in the tables: the two low bits tag a symbol (0),
+ * a character (1) or a number (2), and the remaining bits hold the symbol's
+ * index in the symbol list, the code point or the number. Rows are streamed
+ * straight from the BDD enumerator, one chunk per batch. */
+
+void driver::save_bin(const string& fname) const {
+	if (!tbl) return;
+	ofstream os(fname, ios::binary);
+	if (!os) { o::err() << "Cannot open " << fname << endl; return; }
+	o::inf() << "Saving " << fname << endl;
+	auto put = [&os](uint32_t x) { os.write((const char*)&x, sizeof x); };
+	auto put_lexeme = [&os, &put](const lexeme& l) {
+		put(l[1] - l[0]), os.write((const char*)l[0], l[1] - l[0]);
+	};
+	os.write("TMLC", 4), put(1);
+	put(tbl->dict.nsyms());
+	for (size_t n = 0; n != tbl->dict.nsyms(); ++n)
+		put_lexeme(tbl->dict.get_sym_lexeme(n));
+	for (ntable tab = 0; (size_t)tab != tbl->tbls.size(); ++tab) {
+		const table& t = tbl->tbls[tab];
+		if ((!tbl->opts.show_hidden && t.hidden) || t.is_builtin())
+			continue;
+		put_lexeme(tbl->dict.get_rel_lexeme(get<0>(t.s))), put(t.len);
+		auto chunk = [&os, &put, &t](const int_t* const* cols, size_t n) {
+			put(n);
+			for (size_t k = 0; k != t.len; ++k)
+				os.write((const char*)cols[k], n * sizeof(int_t));
+		};
+		tbl->decompress_batch(t.t, t.len, chunk);
+		put(0);
+	}
+}
@@ -180,6 +180,7 @@ body tables::get_body(const term& t, const varmap& vm, size_t len) const {
 		else if (m.end() == (it = m.find(t[n]))) m.emplace(t[n], n);
 		else b.q = b.q && from_sym_eq(n, it->second, t.size()),
 			get_var_ex(n, t.size(), b.ex);
+	b.op = bdd_op_id(b.ex, b.perm);
 	return b;
 }
 
@@ -209,6 +210,10 @@ bool tables::get_facts(const flat_prog& m) {
 		tbls[x.first].t = x.second;
 	for (auto x: from_facts(del, inverses))
 		tbls[x.first].t = tbls[x.first].t % x.second;
+	for (auto& x : bulk)
+		tbls[x.first].t = tbls[x.first].t ||
+			from_bulk(x.second, tbls[x.first].len);
+	bulk.clear();
 	if (opts.optimize)
 		(o::ms() << "# get_facts: "),
 		measure_time_end();
@@ -418,7 +423,8 @@ void tables::get_alt(const term_set& al, const term& h, set<alt>& as, bool blt)
 				a.varbodies.insert({ x.second[n], a.back() });
 	}
 	auto d = deltail(a.varslen, h.size());
-	a.ex = d.first, a.perm = d.second, as.insert(a);
+	a.ex = d.first, a.perm = d.second, a.op = bdd_op_id(a.ex, a.perm);
+	as.insert(a);
 }
 
 void tables::get_form(const term_set& al, const term& h, set<alt>& as) {
@@ -622,8 +628,8 @@ spbdd_handle tables::body_query(body& b, size_t /*DBG(len)*/) {
 //	DBG(assert(bdd_nvars(b.q) <= b.ex.size());)
 	if (b.tlast && b.tlast->b == tbls[b.tab].t->b) return b.rlast;
 	b.tlast = tbls[b.tab].t;
-	return b.rlast = (b.neg ? bdd_and_not_ex_perm : bdd_and_ex_perm)
-		(b.q, tbls[b.tab].t, b.ex, b.perm);
+	return b.rlast = b.neg ? bdd_and_not_ex_perm(b.q, tbls[b.tab].t, b.op)
+		: bdd_and_ex_perm(b.q, tbls[b.tab].t, b.op);
 //	DBG(assert(bdd_nvars(b.rlast) < len*bits);)
 //	if (b.neg) b.rlast = bdd_and_not_ex_perm(b.q, ts[b.tab].t, b.ex,b.perm);
 //	else b.rlast = bdd_and_ex_perm(b.q, ts[b.tab].t, b.ex, b.perm);
@@ -690,39 +696,57 @@ spbdd_handle tables::alt_query(alt& a, size_t /*DBG(len)*/) {
 	} else if (opts.bproof == proof_mode::none) {
 		// The case where the conjuncts changed but do not have to produce proof
 		a.last = move(v1);
-		a.rlast = bdd_and_many_ex_perm(a.last, a.ex, a.perm);
+		a.rlast = bdd_and_many_ex_perm(a.last, a.op);
 	} else {
 		// The case where the conjuncts changed and we will have to produce proof
 		a.last = move(v1);
 		// Following value is needed as it contains all body variable instantiations
 		a.unquantified_last = bdd_and_many(a.last);
 		a.levels.emplace(nstep, a.unquantified_last);
-		a.rlast = bdd_permute_ex(a.unquantified_last, a.ex, a.perm);
+		a.rlast = bdd_permute_ex(a.unquantified_last, a.op);
 	}
 	return a.rlast;
 }
 
+/* Check whether the solutions of the given alternative can only grow as the
+ * tables it queries grow. */
+
+bool tables::is_monotone(const alt& a) const {
+	if (a.f || a.grnd || !a.bltins.empty() || a.empty()) return false;
+	for (const body* b : a) if (b->neg) return false;
+	return true;
+}
+
+/* Compute the solutions of the given monotone alternative that may be new in
+ * this step. All solutions derivable from the previous step's database are
+ * already in the head table, so a new solution must satisfy some body term
+ * through a fact added in the previous step. Hence evaluate the alternative
+ * once per body term, against the delta of that term's table and the full
+ * tables of the other terms. */
+
+spbdd_handle tables::alt_query_delta(alt& a) {
+	bdd_handles full(a.size()), r;
+	for (size_t n = 0; n != a.size(); ++n)
+		if (hfalse == (full[n] = body_query(*a[n], a.varslen))) return hfalse;
+	for (size_t n = 0; n != a.size(); ++n) {
+		const body& b = *a[n];
+		if (tbls[b.tab].delta == hfalse) continue;
+		spbdd_handle d = bdd_and_ex_perm(b.q, tbls[b.tab].delta, b.op);
+		if (d == hfalse) continue;
+		bdd_handles v = { a.rng, a.eq, d };
+		for (size_t k = 0; k != a.size(); ++k) if (k != n) v.push_back(full[k]);
+		r.push_back(bdd_and_many_ex_perm(move(v), a.op));
+	}
+	return bdd_or_many(move(r));
+}
+
 bool table::commit(DBG(size_t /*bits*/)) {
 	if (add.empty() && del.empty()) return false;
 	spbdd_handle x;
-	if (add.empty()) x = t % bdd_or_many(move(del));
-	else if (del.empty()) add.push_back(t), x = bdd_or_many(move(add));
-	else {
-		// check for any intersection between add and del
-		sort(add.begin(), add.end(), handle_cmp);
-		sort(del.begin(), del.end(), handle_cmp);
-		auto ita = add.begin(), itd = del.begin();
-		while (ita != add.end() && itd != del.end())
-			if (handle_cmp(*ita, *itd)) ita++;
-			else if (!handle_cmp(*itd, *ita)) // contradiction
-				return (add.clear(), del.clear()), unsat = true;
-			else itd++;
-		spbdd_handle a = bdd_or_many(move(add)),
-			d = bdd_or_many(move(del));
-		//DBG(assert(bdd_nvars(a) < len*bits);)
-		//DBG(assert(bdd_nvars(d) < len*bits);)
-		x = (t || a) % d;
-	}
+	bool ok = bdd_update(t, move(add), move(del), x);
+	add.clear(), del.clear();
+	// The same BDD is both inserted and deleted: contradiction
+	if (!ok) return unsat = true;
 	//DBG(assert(bdd_nvars(x) < len*bits);)
 	return x != t && (t = x, true);
 }
@@ -741,12 +765,22 @@ bool tables::print_updates_check() {
 }
 
 char tables::fwd() noexcept {
+	// Without deletions tables only grow, so rules can be evaluated against
+	// the facts added in the previous step. Proofs and updates need the full
+	// results of every step.
+	const bool sn = datalog && opts.semi_naive &&
+		opts.bproof == proof_mode::none &&
+		!print_updates && !populate_tml_update;
+	if (sn) for (table& tbl : tbls)
+		tbl.delta = tbl.t % tbl.prev, tbl.prev = tbl.t;
 	for (rule& r : rules) {
 		bdd_handles v(r.size());
 		spbdd_handle x;
+		const bool rsn = sn && !tbls[r.tab].is_builtin();
 		for (size_t n = 0; n != r.size(); ++n)
 			//print(COUT << "rule: ", r) << endl,
-			v[n] = alt_query(*r[n], r.len);
+			v[n] = rsn && is_monotone(*r[n]) ? alt_query_delta(*r[n]) :
+				alt_query(*r[n], r.len);
 		if (v == r.last) { if (datalog) continue; x = r.rlast; }
 		else r.last = v, x = r.rlast = bdd_or_many(move(v)) && r.eq;
 		//DBG(assert(bdd_nvars(x) < r.len*bits);)
@@ -787,6 +821,22 @@ bdd_handles tables::get_front() const {
 	return r;
 }
 
+/* Append the given database to the sequence of databases computed so far,
+ * noting where it occurred before if it did. */
+
+void tables::add_front(const bdd_handles& l) {
+	bdds k(l.size());
+	for (size_t n = 0; n != l.size(); ++n) k[n] = l[n]->b;
+	auto it = front_idx.emplace(move(k), fronts.size());
+	if (it.second) front_repeat = -1;
+	else front_repeat = it.first->second, it.first->second = fronts.size();
+	fronts.push_back(l);
+}
+
+void tables::clear_fronts() {
+	fronts.clear(), front_idx.clear(), front_repeat = -1;
+}
+
 bool tables::contradiction_detected() {
 	error = true, o::err() << err_contradiction << endl;
 #ifdef WITH_EXCEPTIONS
@@ -842,7 +892,7 @@ bool tables::add_fixed_point_fact() {
 bool tables::pfp(size_t nsteps, size_t break_on_step) {
 	error = false;
 	bdd_handles l = get_front();
-	fronts.push_back(l);
+	add_front(l);
 	if (opts.bproof != proof_mode::none) levels.emplace_back(l);
 	for (;;) {
 		if (print_steps) o::inf() << "# step: " << nstep << endl;
@@ -850,14 +900,15 @@ bool tables::pfp(size_t nsteps, size_t break_on_step) {
 		bool fwd_ret = fwd();
 		if (halt) return true;
 		bdd_handles l = get_front();
+		// All live BDDs are held by handles in between steps
+		bdd::gc_check();
 		if (!fwd_ret && opts.fp_step && add_fixed_point_fact()) return pfp();
-		fronts.push_back(l);
+		add_front(l);
 		if (halt) return true;
 		if (unsat) return contradiction_detected();
 		if ((break_on_step && nstep == break_on_step) ||
 			(nsteps && nstep == nsteps)) return false; // no FP yet
-		bool is_repeat = (!fwd_ret) ||
-			(std::find(fronts.begin(), fronts.end() - 1, l) != fronts.end() - 1);
+		bool is_repeat = !fwd_ret || front_repeat >= 0;
 		if (opts.bproof != proof_mode::none) levels.push_back(move(l));
 		if (is_repeat) return is_infloop() ? infloop_detected() : true;
 	}
@@ -982,6 +1033,8 @@ bool tables::add_prog_wprod(flat_prog m, const vector<production>& g/*, bool mkn
 	//if (mknums) to_nums(m);
 	if (populate_tml_update) init_tml_update();
 	rules.clear(), datalog = true;
+	// Evaluate the first step against the full tables
+	for (table& tbl : tbls) tbl.prev = tbl.delta = hfalse;
 
 	#ifndef LOAD_STRS
 	for (auto x : strs) load_string(x.first, x.second);
@@ -1064,11 +1117,11 @@ bool tables::run_prog(const raw_prog& p, const strs_t& strs_in, size_t steps,
 	bool r = true;
 	// run program only if there are any rules
 	if (rules.size()) {
-		fronts.clear();
+		clear_fronts();
 		r = pfp(steps ? nstep + steps : 0, break_on_step);
 	} else {
 		bdd_handles l = get_front();
-		fronts = {l, l};
+		clear_fronts(), add_front(l), add_front(l);
 	}
 	//----------------------------------------------------------
 	//TODO: prog_after_fp is required for grammar/str recognition,
@@ -1142,9 +1195,7 @@ vbools tables::allsat(spbdd_handle x, size_t args) const {
 
 bool tables::compute_fixpoint(bdd_handles &trues, bdd_handles &falses, bdd_handles &undefineds) {
 	const int_t fronts_size = fronts.size(), tbls_size = tbls.size();
-	if(fronts_size < 2 ||
-			std::find(fronts.begin(), fronts.end()-1, fronts.back()) ==
-			fronts.end()-1) {
+	if(fronts_size < 2 || front_repeat < 0) {
 		// There cannot be a fixpoint if there are less than two fronts or
 		// if there do not exist two equal fronts
 		return false;
@@ -1156,9 +1207,7 @@ bool tables::compute_fixpoint(bdd_handles &trues, bdd_handles &falses, bdd_handl
 		undefineds.resize(tbls_size);
 		// Loop back to the first repetition of the last front. It is clear
 		// that the set of intervening fronts are periodic
-		int_t cycle_start;
-		for(cycle_start = fronts_size - 2;
-			fronts[cycle_start] != fronts.back(); cycle_start--);
+		int_t cycle_start = front_repeat;
 		// Make a buffer to hold the sequence of states a single table
 		// eventually cycles through
 		bdd_handles cycle(fronts_size - 1 - cycle_start);
@@ -1187,21 +1236,17 @@ void tables::decompress(spbdd_handle x, ntable tab, const cb_decompress& f,
 	table tbl = tbls.at(tab);
 	if (!allowbltins && tbl.is_builtin()) return; //bltins no decompress
 	if (!len) len = tbl.len;
-	allsat_cb(x/*&&ts[tab].t*/, len * bits,
-		[tab, &f, &tbl, len, this](const bools& p, bdd_ref  DBG(y)) {
-		DBG(assert(BDD_ABS(y) == T);)
-		term r(false, term::REL, NOP, tab, ints(len, 0), 0);
-		for (size_t n = 0; n != len; ++n)
-			for (size_t k = 0; k != bits; ++k)
-				if (p[pos(k, n, len)])
-					r[n] |= 1 << k;
-
+	term r(false, term::REL, NOP, tab, ints(len, 0), 0);
+	auto g = [&r, &f, &tbl, len, this](const int_t* const* cols, size_t m) {
+		for (size_t i = 0; i != m; ++i) {
+			for (size_t n = 0; n != len; ++n) r[n] = cols[n][i];
 #ifdef BIT_TRANSFORM
-		if (ir_handler->bitunv_decompress(r, tbl))
+			if (ir_handler->bitunv_decompress(r, tbl))
 #endif
-		f(r);
-
-	})();
+			f(r);
+		}
+	};
+	decompress_batch(x/*&&ts[tab].t*/, len, g);
 }
 
 set<term> tables::decompress() {
@@ -39,6 +39,8 @@ struct body {
 	ntable tab;
 	bools ex;
 	uints perm;
+	// The ID of the interned ex and perm operation
+	size_t op = 0;
 	spbdd_handle q, tlast, rlast;
 	bool operator<(const body& t) const {
 		if (q != t.q) return q < t.q;
@@ -63,6 +65,8 @@ struct alt : public std::vector<body*> {
 	std::vector<term> bltins; // builtins to run during alt_query
 	bools ex;
 	uints perm;
+	// The ID of the interned ex and perm operation
+	size_t op = 0;
 	varmap vm;
 	std::map<size_t, spbdd_handle> levels;
 
@@ -141,6 +145,9 @@ struct table {
 	sig s;
 	size_t len, priority = 0;
 	spbdd_handle t = hfalse;
+	// t as of the start of the previous step and the facts added since then.
+	// Only maintained for semi-naive evaluation.
+	spbdd_handle prev = hfalse, delta = hfalse;
 	bdd_handles add, del;
 	std::vector<size_t> r;
 	bool unsat = false, tmp = false;
@@ -202,6 +209,10 @@ private:
 	std::vector<table> tbls;
 	std::vector<rule> rules;
 	std::vector<bdd_handles> fronts;
+	// Maps the roots of each front to the index of its last occurrence
+	std::unordered_map<bdds, size_t> front_idx;
+	// Index of the previous occurrence of the last front, or -1 if none
+	int_t front_repeat = -1;
 	std::vector<bdd_handles> levels;
 
 	void get_sym(int_t s, size_t arg, size_t args, spbdd_handle& r) const;
@@ -286,11 +297,24 @@ private:
 	spbdd_handle addtail(cr_spbdd_handle x, size_t len1, size_t len2) const;
 	spbdd_handle body_query(body& b, size_t);
 	spbdd_handle alt_query(alt& a, size_t);
+	bool is_monotone(const alt& a) const;
+	spbdd_handle alt_query_delta(alt& a);
 
 //#ifdef PROOF
 	DBG(vbools allsat(spbdd_handle x, size_t args) const;)
 	void decompress(spbdd_handle x, ntable tab, const cb_decompress&,
 		size_t len = 0, bool allowbltins = false) const;
+	// Enumerates the tuples of the len-ary relation x in batches, calling
+	// f(cols, n) where cols[k] holds the n values of argument k
+	template <typename F>
+	void decompress_batch(spbdd_handle x, size_t len, F& f) const {
+		std::vector<size_t> c(len * bits);
+		std::vector<int_t> w(len * bits);
+		for (size_t n = 0; n != len; ++n)
+			for (size_t k = 0; k != bits; ++k)
+				c[pos(k, n, len)] = n, w[pos(k, n, len)] = 1 << k;
+		allsat_batch<F>(x, len * bits, move(c), move(w), len, f)();
+	}
 	std::set<term> decompress();
 	rule new_identity_rule(ntable tab, bool neg);
 	bool is_term_valid(const term &t);
@@ -337,9 +361,15 @@ private:
 	bool infloop_detected();
 	char fwd() noexcept;
 	bdd_handles get_front() const;
+	void add_front(const bdd_handles& l);
+	void clear_fronts();
 	bool bodies_equiv(std::vector<term> x, std::vector<term> y) const;
 	std::set<term> goals;
 	std::set<ntable> to_drop;
+	// Row major tuples of already encoded values loaded by load_facts and
+	// turned into BDDs by get_facts
+	std::map<ntable, ints> bulk;
+	spbdd_handle from_bulk(const ints& v, size_t len) const;
 #ifndef LOAD_STRS
 	void load_string(lexeme rel, const string_t& s);
 	strs_t strs;
@@ -464,6 +494,7 @@ public:
 	~tables();
 	size_t step() { return nstep; }
 	bool add_prog_wprod(const raw_prog& p, const strs_t& strs);
+	bool load_facts(const std::string& fname);
 
 	static bool run_prog_wedb(const std::set<raw_term> &edb, raw_prog rp,
 		dict_t &dict, const options &opts, std::set<raw_term> &results);
@@ -128,9 +128,15 @@ bool tables::init_builtins() {
 		x = bdd_permute_ex(x,ex,perm);
 		//COUT << "count after ex\n";
 		//::out(COUT, x)<<endl<<endl;
-		size_t cnt2 = satcount(x, (bits) * (c.a->varslen-varsout));
-		//DBG(COUT << "count2 result: " << cnt2 << endl;)
-		c.out(from_sym(c.outvarpos(), c.a->varslen, mknum(cnt2)));
+		big_uint cnt = satcount_exact(x, (bits) * (c.a->varslen-varsout));
+		//DBG(COUT << "count2 result: " << cnt << endl;)
+		uint64_t cnt2;
+		if (!cnt.get(cnt2, (uint64_t)numeric_limits<int_t>::max() >> 2)) {
+			o::err() << "count: " << cnt <<
+				" does not fit in a number" << endl;
+			return;
+		}
+		c.out(from_sym(c.outvarpos(), c.a->varslen, mknum((int_t)cnt2)));
 	}, -1);
 
 	return  init_bdd_builtins() &&
@@ -742,6 +742,7 @@ void tables::handler_form1(pnft_handle &p, form *f, varmap &vm, varmap &vmh, boo
 				//::out(COUT, auxq)<<endl<<endl;
 				#ifndef TYPE_RESOLUTION
 				ex_typebits(p0->b->ex, f->tm->size());
+				p0->b->op = bdd_op_id(p0->b->ex, p0->b->perm);
 				#endif
 				static set<body*, ptrcmp<body>>::const_iterator bit;
 				if ((bit = p->bodies.find(p0->b)) == p->bodies.end())
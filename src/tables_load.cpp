@@ -0,0 +1,177 @@
+// LICENSE
+// This software is free for use and redistribution while including this
+// license notice, unless:
+// 1. is used for commercial or non-personal purposes, or
+// 2. used for a product which includes or associated with a blockchain or other
+// decentralized database technology, or
+// 3. used for a product which includes or associated with the issuance or use
+// of cryptographic or electronic currencies/coins/tokens.
+// On all of the mentioned cases, an explicit and written permission is required
+// from the Author (Ohad Asor).
+// Contact ohad@idni.org for requesting a permission. This license may be
+// modified over time by the Author.
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+#include "tables.h"
+using namespace std;
+
+/* Bulk loading of facts, bypassing the parser and the ir_builder.
+ *
+ * A file is either a binary columnar file as written by driver::save_bin,
+ * recognized by its "TMLC" signature, or a text file holding one fact of
+ * the relation named after the file's base name per line, its arguments
+ * separated by tabs (or by commas in .csv files when there is no tab), as
+ * written by driver::save_csv. Text arguments consisting of digits only are
+ * numbers, 'c' is a character and anything else, possibly double quoted, is
+ * a symbol. Values are encoded and stored in bulk, and get_facts turns each
+ * table's tuples into a BDD in a single pass over them, see from_bulk. */
+
+bool tables::load_facts(const string& fname) {
+	ifstream is(fname, ios::binary);
+	if (!is) return o::err() << "Cannot open " << fname << endl, false;
+	string s((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+	auto fail = [&fname](const string& msg) {
+		return o::err() << fname << ": " << msg << endl, false;
+	};
+	auto add_val = [this](int_t v) {
+		if ((v & 3) == 1) ir_handler->chars =
+			max(ir_handler->chars, (int_t)(v >> 2));
+		else if ((v & 3) == 2) ir_handler->nums =
+			max(ir_handler->nums, (int_t)(v >> 2));
+	};
+	auto get_table = [this](const lexeme& rel, size_t len) {
+		return ir_handler->get_table(ir_handler->get_sig(rel, {(int_t)len}));
+	};
+	if (s.compare(0, 4, "TMLC") == 0) {
+		const char* p = s.data() + 4, * e = s.data() + s.size();
+		uint32_t x;
+		auto get = [&p, e, &x]() {
+			if ((size_t)(e - p) < sizeof x) return false;
+			return memcpy(&x, p, sizeof x), p += sizeof x, true;
+		};
+		auto get_lexeme = [this, &p, e, &get, &x](lexeme& l) {
+			if (!get() || (size_t)(e - p) < x) return false;
+			return l = dict.get_lexeme((ccs)p, x), p += x, true;
+		};
+		if (!get() || x != 1) return fail("unsupported version");
+		if (!get()) return fail("truncated");
+		dict.reserve_syms(x);
+		ints syms(x);
+		lexeme l;
+		for (int_t& sym : syms)
+			if (!get_lexeme(l)) return fail("truncated");
+			else sym = dict.get_sym(l);
+		while (p != e) {
+			if (!get_lexeme(l) || !get()) return fail("truncated");
+			const size_t len = x;
+			ints& v = bulk[get_table(l, len)];
+			for (;;) {
+				if (!get()) return fail("truncated");
+				if (!x) break;
+				const size_t n = x, r = v.size() / max(len, (size_t)1);
+				if ((size_t)(e - p) < n * len * sizeof(int_t))
+					return fail("truncated");
+				if (!len) { v.push_back(0); continue; }
+				v.resize(v.size() + n * len);
+				// transpose the columns of the chunk into rows
+				for (size_t k = 0; k != len; ++k)
+					for (size_t i = 0; i != n; ++i) {
+						int_t y;
+						memcpy(&y, p, sizeof y), p += sizeof y;
+						if ((y & 3) == 0) {
+							if ((size_t)(y >> 2) >= syms.size())
+								return fail("bad symbol");
+							y = mksym(syms[y >> 2]);
+						}
+						add_val(y), v[(r + i) * len + k] = y;
+					}
+			}
+		}
+		return true;
+	}
+	size_t b = fname.find_last_of('/'), d;
+	b = b == string::npos ? 0 : b + 1, d = fname.find('.', b);
+	const string rel = fname.substr(b, d == string::npos ? d : d - b);
+	if (rel.empty()) return fail("cannot derive a relation name");
+	char sep = '\t';
+	if (s.find('\t') == string::npos && d != string::npos &&
+		fname.compare(d, string::npos, ".csv") == 0) sep = ',';
+	unordered_map<string, int_t> symcache;
+	ints v;
+	string f;
+	size_t len = SIZE_MAX, line = 0;
+	for (size_t i = 0, j, e; i < s.size(); i = j + 1, ++line) {
+		if ((j = s.find('\n', i)) == string::npos) j = s.size();
+		if ((e = j) > i && s[e - 1] == '\r') --e;
+		if (e == i) continue;
+		size_t k = 0;
+		for (size_t m = i, q; ; m = q + 1, ++k) {
+			if ((q = s.find(sep, m)) == string::npos || q > e) q = e;
+			f.assign(s, m, q - m);
+			int_t y = 0;
+			if (!f.empty() && all_of(f.begin(), f.end(), ::isdigit)) {
+				// numbers are stored shifted left by two bits
+				uint64_t u = 0;
+				for (char c : f)
+					if ((u = u * 10 + (c - '0')) >
+						(uint64_t)numeric_limits<int_t>::max() >> 2)
+						return fail("number too big at line "
+							+ to_string(line + 1));
+				y = mknum((int_t)u);
+			} else if (f.size() > 2 && f.front() == '\''
+				&& f.back() == '\'') {
+				char32_t ch;
+				if (peek_codepoint((ccs)f.c_str() + 1, f.size() - 2,
+					ch) != f.size() - 2)
+					return fail("bad character at line "
+						+ to_string(line + 1));
+				y = mkchr(ch);
+			} else {
+				if (f.size() > 1 && f.front() == '"' && f.back() == '"') {
+					string u;
+					for (size_t n = 1; n + 1 < f.size(); ++n)
+						if (f[n] == '\\' && n + 2 < f.size()) u += f[++n];
+						else u += f[n];
+					f = u;
+				}
+				auto it = symcache.find(f);
+				if (it == symcache.end()) it = symcache.emplace(f,
+					mksym(dict.get_sym(dict.get_lexeme(f)))).first;
+				y = it->second;
+			}
+			add_val(y), v.push_back(y);
+			if (q == e) break;
+		}
+		if (len == SIZE_MAX) len = k + 1;
+		else if (len != k + 1) return fail("expected " + to_string(len)
+			+ " arguments at line " + to_string(line + 1));
+	}
+	if (len == SIZE_MAX) return true;
+	ints& t = bulk[get_table(dict.get_lexeme(rel), len)];
+	if (t.empty()) t = move(v);
+	else t.insert(t.end(), v.begin(), v.end());
+	return true;
+}
+
+/* Builds the BDD of a len-ary relation from its row major tuples. Every row
+ * is turned into a key holding its bits in the order of the BDD variables,
+ * as laid out by pos, and the keys are handed to from_keys which sorts them
+ * and builds the BDD bottom up. A nullary relation with any row is true. */
+
+spbdd_handle tables::from_bulk(const ints& v, size_t len) const {
+	if (v.empty()) return hfalse;
+	if (!len) return htrue;
+	const size_t nvars = len * bits, words = (nvars + 63) / 64,
+		n = v.size() / len;
+	vector<uint64_t> keys(n * words, 0);
+	for (size_t i = 0; i != n; ++i)
+		for (size_t a = 0; a != len; ++a)
+			for (size_t k = 0; k != bits; ++k)
+				if ((v[i * len + a] >> k) & 1) {
+					const size_t p = pos(k, a, len);
+					keys[i * words + p / 64] |=
+						uint64_t(1) << (63 - p % 64);
+				}
+	return from_keys(move(keys), words, nvars);
+}
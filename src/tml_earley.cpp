@@ -17,6 +17,7 @@
 #include <sstream>
 #include <forward_list>
 #include <functional>
+#include <memory>
 #include <cctype>
 #include <ctime>
 #include <locale>
@@ -53,20 +54,23 @@ bool driver::earley_parse_tml(input* in, raw_progs& rps) {
 			return c < 256 && isspace(c); } },
 		{ U"digit",         [](const char32_t& c)->bool {
 			return c < 256 && isdigit(c); } },
-		{ U"alpha",     [&eof](const char32_t& c)->bool {
+		{ U"alpha",     [eof](const char32_t& c)->bool {
 			return c != eof && (c > 160 || isalpha(c)); } },
-		{ U"alnum",     [&eof](const char32_t& c)->bool {
+		{ U"alnum",     [eof](const char32_t& c)->bool {
 			return c != eof && (c > 160 || isalnum(c)); } },
-		{ U"printable", [&eof](const char32_t& c)->bool {
+		{ U"printable", [eof](const char32_t& c)->bool {
 			return c != eof && (c > 160 || isprint(c)); } },
-		{ U"eof",       [&eof](const char32_t& c)->bool {
+		{ U"eof",       [eof](const char32_t& c)->bool {
 			return c == eof; } }
 	};
-	auto g = load_tml_grammar();
-	earley_t parser(g, bltnmap, opts.enabled("bin-lr"));
+	const bool bin_lr = opts.enabled("bin-lr");
+	if (!tml_parser || tml_parser_bin_lr != bin_lr)
+		tml_parser = make_unique<earley_t>(load_tml_grammar(), bltnmap,
+			bin_lr), tml_parser_bin_lr = bin_lr;
+	earley_t& parser = *tml_parser;
 	o::inf() << "\n### parser.recognize() : ";
 	bool success = parser
-		.recognize(to_u32string(string_t(in->data())));
+		.reparse(to_u32string(string_t(in->data())));
 	o::inf() << (success ? "OK" : "FAIL")<<
 		" <###\n" << endl;
 	parsing_context ctx(rps);
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <cmath>
+#include "../../src/bdd.h"
+using namespace std;
+
+// Count the satisfying assignments of x over the first nvars variables by
+// enumerating them
+
+size_t brute_count(cr_spbdd_handle x, bdd_shft nvars) {
+  size_t count = 0;
+  for(size_t a = 0; a < (size_t(1) << nvars); a++) {
+    spbdd_handle y = x;
+    for(bdd_shft v = 0; v < nvars; v++)
+      y = y && from_bit(v, (a >> v) & 1);
+    if(y != hfalse) count++;
+  }
+  return count;
+}
+
+// Test model counting against enumeration and on universes too wide for
+// machine integers
+
+int main() {
+  bdd::init();
+  const bdd_shft nvars = 4;
+  spbdd_handle x1 = from_bit(0, true), x2 = from_bit(1, false),
+    x4 = from_bit(3, true);
+  spbdd_handle funcs[] = { hfalse, htrue, x1, x2, x4, x1 && x2, x2 || x4,
+    bdd_not(x1 && x4), bdd_xor(x1, bdd_xor(x2, x4)),
+    bdd_ite(x1, x2, bdd_not(x4)) };
+  for(const spbdd_handle &f : funcs) {
+    size_t expected = brute_count(f, nvars);
+    if(satcount(f, nvars) != expected ||
+        satcount_exact(f, nvars) != big_uint(expected)) {
+      cout << "Error: exact count differs from enumeration: " <<
+        satcount_exact(f, nvars) << " != " << expected << endl;
+      return 1;
+    }
+    double l = satcount_log2(f, nvars);
+    if(expected ? fabs(exp2(l) - expected) > 1e-9 : !isinf(l)) {
+      cout << "Error: log2 count differs from enumeration." << endl;
+      return 1;
+    }
+  }
+  // The parity function has exponentially many paths but linearly many nodes
+  const bdd_shft wide = 300;
+  spbdd_handle parity = hfalse;
+  for(bdd_shft v = wide; v--;)
+    parity = bdd_ite(from_bit(v, true), bdd_not(parity), parity);
+  big_uint half = 1;
+  half <<= wide - 1;
+  if(satcount_exact(parity, wide) != half ||
+      half.to_string() != "101851798816724304313422284420468908052573419683296"
+        "8125318070224677190649881668353091698688") {
+    cout << "Error: wide parity count is " << satcount_exact(parity, wide) << endl;
+    return 1;
+  }
+  if(fabs(satcount_log2(parity, wide) - (wide - 1)) > 1e-9 ||
+      satcount(parity, wide) != SIZE_MAX) {
+    cout << "Error: wide parity count does not saturate or has wrong log2." << endl;
+    return 1;
+  }
+  cout << "Success: model counts are exact." << endl;
+  return 0;
+}
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+rm -f ./satcount_test
+ret=0
+
+g++ satcount_test.cpp \
+	../../build-Release/libTML.a \
+	-W -Wall -Wextra -Wpedantic \
+	-DGIT_DESCRIBED=1 -DGIT_COMMIT_HASH=1 -DGIT_BRANCH=1 \
+	-DWITH_THREADS=TRUE \
+	-std=c++17 -O0 -DDEBUG -ggdb3 -osatcount_test -lgcov \
+					&& ./satcount_test
+
+ret=$?
+rm -f ./satcount_test
+exit $ret
@@ -0,0 +1,40 @@
+#include <iostream>
+#include "../../src/bdd.h"
+using namespace std;
+
+// Check that conjoining many BDDs while quantifying early agrees with
+// conjoining them all first and quantifying and renaming the product
+
+int main() {
+  bdd::init();
+  const bdd_shft nvars = 10;
+  spbdd_handle x[nvars];
+  for(bdd_shft v = 0; v < nvars; v++) x[v] = from_bit(v, true);
+  // Chained conjuncts, so that each quantified variable is shared by
+  // several of them and can only go once the last of those is conjoined
+  bdd_handles v;
+  for(bdd_shft i = 0; i + 2 < nvars; i++)
+    v.push_back(bdd_ite(x[i], bdd_xor(x[i + 1], x[i + 2]),
+      x[i + 1] || bdd_not(x[i + 2])));
+  // Quantifies the odd variables, and renames the others either by moving
+  // them all by the same offset or by reversing them
+  bools ex(nvars);
+  for(bdd_shft i = 1; i < nvars; i += 2) ex[i] = true;
+  bdd_shfts shifted(nvars), reversed(nvars);
+  for(bdd_shft i = 0; i < nvars; i++)
+    shifted[i] = i + 3, reversed[i] = nvars - 1 - i;
+  int ret = 0;
+  for(size_t n = 5; n <= v.size(); n++) {
+    bdd_handles w(v.begin(), v.begin() + n);
+    spbdd_handle all = bdd_and_many(w);
+    for(const bdd_shfts* p : { &shifted, &reversed }) {
+      if(bdd_and_many_ex_perm(w, ex, *p) != bdd_permute_ex(all, ex, *p)) {
+        cout << "Error: scheduled conjunction of " << n <<
+          " BDDs differs from the unscheduled one." << endl;
+        ret = 1;
+      }
+    }
+  }
+  if(!ret) cout << "Success: scheduled conjunctions agree." << endl;
+  return ret;
+}
@@ -0,0 +1,50 @@
+#include <iostream>
+#include "../../src/bdd.h"
+using namespace std;
+
+// Check that a quantification followed by a renaming that moves every
+// variable by the same offset gives the renamed BDD whether or not the BDD
+// depends on variables past the renaming, which must stay in place
+
+int check(const char* what, cr_spbdd_handle x, cr_spbdd_handle expected) {
+  if(x == expected) return 0;
+  cout << "Error: " << what << " differs from the expected BDD." << endl;
+  return 1;
+}
+
+int main() {
+  bdd::init();
+  spbdd_handle x0 = from_bit(0, true), x1 = from_bit(1, true),
+    x2 = from_bit(2, true), x3 = from_bit(3, true), x5 = from_bit(5, true);
+  // Moves x0 to x2 and x1 to x3, leaving x2 and beyond alone
+  const bools none = { false, false };
+  const bdd_shfts by2 = { 2, 3 };
+  int ret = 0;
+  ret |= check("permute_ex within the renaming",
+    bdd_permute_ex(x0 % x1, none, by2), x2 % x3);
+  ret |= check("permute_ex past the renaming",
+    bdd_permute_ex(x0 && x3, none, by2), x2 && x3);
+  ret |= check("permute_ex past the renaming by op ID",
+    bdd_permute_ex(x0 && x5, bdd_op_id(none, by2)), x2 && x5);
+  ret |= check("and_ex_perm past the renaming",
+    bdd_and_ex_perm(x0, x3, none, by2), x2 && x3);
+  ret |= check("and_ex_perm past the renaming by op ID",
+    bdd_and_ex_perm(x1, x5, bdd_op_id(none, by2)), x3 && x5);
+  ret |= check("and_many_ex_perm past the renaming",
+    bdd_and_many_ex_perm({ x0, x1 % x0, x3 }, none, by2), hfalse);
+  ret |= check("and_many_ex_perm past the renaming",
+    bdd_and_many_ex_perm({ x0, x1, x5 }, none, by2), x2 && x3 && x5);
+  // Quantifies x0 and moves x1 to x2
+  const bools ex0 = { true, false };
+  const bdd_shfts by1 = { 0, 2 };
+  ret |= check("quantifying permute_ex within the renaming",
+    bdd_permute_ex(x0 && x1, ex0, by1), x2);
+  ret |= check("quantifying permute_ex past the renaming",
+    bdd_permute_ex(x0 && x1 && x3, ex0, by1), x2 && x3);
+  ret |= check("quantifying and_ex_perm past the renaming",
+    bdd_and_ex_perm(x0 % x1, x3, ex0, by1), bdd_not(x2) && x3);
+  ret |= check("quantifying and_many_ex_perm past the renaming",
+    bdd_and_many_ex_perm({ x0, x1, x5 }, ex0, by1), x2 && x5);
+  if(!ret) cout << "Success: uniform renamings leave later variables alone." << endl;
+  return ret;
+}
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cstring>
+#include "../../src/bdd.h"
+using namespace std;
+
+// Saves a node store with free IDs in it and loads it in another process,
+// where building the same BDDs again must find them instead of adding nodes
+
+bdd_handles build(unsigned seed) {
+  mt19937 g(seed);
+  bdd_handles r;
+  for (size_t n = 0; n != 8; ++n) {
+    vector<uint64_t> k(300);
+    for (uint64_t& x : k) x = (uint64_t) g() << 32 & ~0xfffffffffffull;
+    r.push_back(from_keys(k, 1, 20));
+  }
+  bdd_shfts p(20);
+  for (size_t v = 0; v != 20; ++v) p[v] = 19 - v;
+  r.push_back(r[0] && r[1]), r.push_back(r[2] || r[3]);
+  r.push_back(bdd_permute_ex(r[4], bools(20, false), p));
+  return r;
+}
+
+int save(const char* fn) {
+  bdd_handles garbage = build(1), roots = build(2);
+  garbage.clear(), bdd::gc();
+  if (bdd_save(fn, roots)) return 0;
+  cout << "Error: cannot save the BDD store." << endl;
+  return 1;
+}
+
+int load(const char* fn) {
+  bdd_handles roots;
+  // A truncated store is refused and leaves the store empty
+  string bad = string(fn) + ".bad";
+  {
+    ifstream is(fn, ios::binary);
+    string s((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+    ofstream(bad, ios::binary).write(s.data(), s.size() / 2);
+  }
+  if (bdd_load(bad, roots) || V.size() != 2) {
+    cout << "Error: a truncated BDD store was loaded." << endl;
+    return 1;
+  }
+  remove(bad.c_str());
+  if (!bdd_load(fn, roots)) {
+    cout << "Error: cannot load the BDD store." << endl;
+    return 1;
+  }
+  if (bdd_load(fn, roots)) {
+    cout << "Error: a BDD store was loaded into a nonempty one." << endl;
+    return 1;
+  }
+  const size_t nodes = V.size();
+  if (build(2) != roots || V.size() != nodes) {
+    cout << "Error: the loaded BDDs are not found when built again." << endl;
+    return 1;
+  }
+  // Free IDs are reused and collected as usual
+  bdd_handles garbage = build(3);
+  garbage.clear(), bdd::gc();
+  if (build(2) != roots) {
+    cout << "Error: the loaded BDDs do not survive a collection." << endl;
+    return 1;
+  }
+  cout << "Success: a saved BDD store is loaded as it was." << endl;
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  bdd::init();
+  if (argc == 3 && !strcmp(argv[1], "save")) return save(argv[2]);
+  if (argc == 3 && !strcmp(argv[1], "load")) return load(argv[2]);
+  cout << "Usage: store_test save|load <file>" << endl;
+  return 1;
+}
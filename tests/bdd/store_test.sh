@@ -0,0 +1,17 @@
+#!/bin/bash
+
+rm -f ./store_test ./store_test.bdd
+ret=0
+
+g++ store_test.cpp \
+	../../build-Release/libTML.a \
+	-W -Wall -Wextra -Wpedantic \
+	-DGIT_DESCRIBED=1 -DGIT_COMMIT_HASH=1 -DGIT_BRANCH=1 \
+	-DWITH_THREADS=TRUE \
+	-std=c++17 -O0 -DDEBUG -ggdb3 -ostore_test -lgcov \
+					&& ./store_test save store_test.bdd \
+					&& ./store_test load store_test.bdd
+
+ret=$?
+rm -f ./store_test ./store_test.bdd
+exit $ret
@@ -119,6 +119,17 @@ test mmap_vector_with_nommap_allocator_int_t_write = [] {
 	return ok();
 };
 
+test vector_with_memory_map_allocator_int_t_grow = [] {
+	memory_map_allocator<int_t> a(TF2);
+	vector<int_t, memory_map_allocator<int_t> > v(a);
+	v.reserve(10);
+	for (int_t i = 0; i != 1000; ++i) v.push_back(i-500);
+	for (int_t i = 0; i != 1000; ++i)
+		if (i-500 != v[i])
+			return fail("vector_with_memory_map_allocator_int_t_grow");
+	return ok();
+};
+
 test temporary = [] {
 	memory_map mm("", S2, MMAP_WRITE);
 	if (mm.error) return fail(mm.error_message);
@@ -156,6 +167,7 @@ int main() {
 		vector_with_memory_map_allocator_int_t_write,
 		vector_with_memory_map_allocator_int_t_read,
 		mmap_vector_with_nommap_allocator_int_t_write,
+		vector_with_memory_map_allocator_int_t_grow,
 		temporary,
 		bdd_mmap_write,
 	};
@@ -37,6 +37,42 @@ int test_out(int c, earley<CharT> &e){
 	return 1;
 }
 
+// parse forest of e as "label(from to) -> children" lines, temporary nodes of
+// a binarized forest are replaced by their children
+template <typename CharT>
+std::set<std::string> forest_edges(earley<CharT> &e) {
+	using namespace std;
+	map<size_t, string> label;
+	map<size_t, vector<size_t>> children;
+	for (auto &f : e.get_parse_graph_facts()) {
+		size_t id = get<size_t>(f[1]);
+		if (get<string>(f[0]) == "edge")
+			children[id].push_back(get<size_t>(f[2]));
+		else if (f.size() == 5) {
+			string l = get<string>(f[2]);
+			if (l.size() > 1 && l[0] == '"') l = l.substr(1, l.size()-2);
+			label[id] = l + "(" + to_string(get<size_t>(f[3])) + " " +
+				to_string(get<size_t>(f[4])) + ")";
+		}
+	}
+	auto temp = [&label](size_t id) {
+		return label[id].rfind("temp", 0) == 0;
+	};
+	function<void(size_t, string&)> expand = [&](size_t id, string &s) {
+		for (size_t c : children[id])
+			if (temp(c)) expand(c, s);
+			else s += " " + label[c];
+	};
+	set<string> r;
+	for (auto &it : children) {
+		if (temp(it.first)) continue;
+		string s = label[it.first] + " ->";
+		expand(it.first, s);
+		r.insert(s);
+	}
+	return r;
+}
+
 int main(int argc, char** argv) {
 	using namespace std;
 	inputs ii;
@@ -121,5 +157,57 @@ int main(int argc, char** argv) {
 	cout << e7.recognize(U"τžluťoučkýτᚠᛇᚻ᛫ᛒᛦᚦ᛫ᚠᚱᚩᚠᚢᚱ᛫ᚠᛁᚱᚪ᛫ᚷᛖᚻᚹᛦᛚᚳᚢᛗτξεσκεπάζωτ") << endl << endl;
 	test_out(c++, e7);
 
-	return 0;
+	// reparsing inputs appended to or edited gives the forest of parsing
+	// them anew
+	earley<char>::grammar g8{ {"start", { {"n"}, { "start", "X", "start" }}},
+				{"X", { {"p"}, {"m"}}} };
+	earley<char> e8(g8, binlr, incr_gen);
+	for (const char* s : { "npn", "npnmn", "npnmnpn", "nmnmnpn", "nmn",
+		"nmnpx", "nmnpn", "", "nmnp" })
+	{
+		earley<char> f(g8, binlr, incr_gen);
+		bool r = e8.reparse(s);
+		cout << (r == f.recognize(s) && e8.get_parse_graph_facts() ==
+			f.get_parse_graph_facts()) << endl;
+	}
+	cout << e8.append("n") << endl;
+
+	// right recursion over a long input, and a Dyck language, give the same
+	// forest with and without a binarized grammar
+	int fails = 0;
+	auto check = [&fails](const char* name, bool ok) {
+		cout << name << ": " << (ok ? "ok" : "fail") << endl;
+		fails += !ok;
+	};
+	const size_t n = 5000;
+	set<string> expected = { "start(0 " + to_string(n) + ") -> S(0 " +
+		to_string(n) + ")" };
+	for (size_t i = 0; i != n - 1; ++i) expected.insert("S(" +
+		to_string(i) + " " + to_string(n) + ") -> a(" + to_string(i) +
+		" " + to_string(i+1) + ") S(" + to_string(i+1) + " " +
+		to_string(n) + ")");
+	expected.insert("S(" + to_string(n-1) + " " + to_string(n) + ") -> a(" +
+		to_string(n-1) + " " + to_string(n) + ")");
+	for (bool b : { false, true }) {
+		earley<char> e9({ { "start", { { "S" } } },
+			{ "S", { { "a", "S" }, { "a" } } } }, b, incr_gen);
+		check("right recursion", e9.recognize(string(n, 'a')) &&
+			e9.count_parsed_trees() == 1 && forest_edges(e9) == expected);
+	}
+	for (bool b : { false, true }) {
+		earley<char> e10({ { "start", { { "D" } } },
+			{ "D", { { "(", "D", ")", "D" }, { "" } } } }, b, incr_gen);
+		check("dyck", e10.recognize("(())()") &&
+			e10.count_parsed_trees() == 1 && forest_edges(e10) ==
+			set<string>{
+				"start(0 6) -> D(0 6)",
+				"D(0 6) -> ((0 1) D(1 3) )(3 4) D(4 6)",
+				"D(1 3) -> ((1 2) D(2 2) )(2 3) D(3 3)",
+				"D(4 6) -> ((4 5) D(5 5) )(5 6) D(6 6)",
+				"D(2 2) -> ε(2 2)", "D(3 3) -> ε(3 3)",
+				"D(5 5) -> ε(5 5)", "D(6 6) -> ε(6 6)" });
+		check("dyck unbalanced", !e10.recognize("(()))("));
+	}
+
+	return fails ? 1 : 0;
 }
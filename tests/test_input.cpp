@@ -61,5 +61,31 @@ TEST_SUITE("input processing test") {
 		in3.prog_lex();
 		CHECK(in3.l.size() == 27);
 	}
+	TEST_CASE("parallel lexing") {
+		// lines ending with '.' inside strings and comments and lines
+		// starting with multi-byte characters are candidate chunk starts
+		string_t prog;
+		for (size_t n = 0; n != 16; ++n) prog += to_string_t(
+			"a(\"x.\nb(y).\n\").\n"
+			"/* c.\nd(z).\n */\n"
+			"# e.\n"
+			"\u017e(\u0142 \"\u00e9.\n\").\n"
+			"\u0161(?x) :- \u017e(?x ?y).\n");
+		auto offsets = [&prog](size_t chunk, size_t threads) {
+			input in(prog.c_str());
+			in.lex_chunk = chunk, in.lex_threads = threads;
+			in.prog_lex();
+			CHECK(!in.error);
+			std::vector<std::pair<size_t, size_t>> r;
+			for (const lexeme& e : in.l) r.emplace_back(
+				e[0] - in.begin(), e[1] - in.begin());
+			return r;
+		};
+		auto seq = offsets(prog.size(), 1);
+		CHECK(seq.size() == 16 * 22);
+		for (size_t t = 2; t != 9; ++t)
+			for (size_t c = 1; c * t <= prog.size(); c += 7)
+				CHECK(offsets(c, t) == seq);
+	}
 }
 